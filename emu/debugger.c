@@ -74,6 +74,37 @@ static const dbg_eam dbg_addrmode[256] = {
 #define FLAG_OVERFLOW  0x40
 #define FLAG_SIGN      0x80
 
+// breakpoint bank qualifier: 0xFF matches any bank
+uint8_t dbg_break_bank = 0xFF;
+
+// Format a bank-qualified address: "BB:XXXX" in banked memory ($8000+), else "XXXX".
+static const char* dbg_addr(char* buf, uint16_t addr) {
+    uint8_t bank = ula_bank_at(addr);
+    if (bank == 0xFF) sprintf(buf, "%04X", addr);
+    else sprintf(buf, "%02X:%04X", bank, addr);
+    return buf;
+}
+
+int dbg_at_break(uint16_t pc) {
+    return pc == dbg_break && (dbg_break_bank == 0xFF || ula_bank_at(pc) == dbg_break_bank);
+}
+
+// Parse a breakpoint "[BB:]XXXX" (hex).
+int dbg_parse_break(const char* str) {
+    unsigned bank, addr;
+    if (sscanf(str, "%x:%x", &bank, &addr) == 2 && bank < 64 && addr < 0x10000) {
+        dbg_break = addr;
+        dbg_break_bank = bank;
+        return 1;
+    }
+    if (sscanf(str, "%x", &addr) == 1 && addr < 0x10000) {
+        dbg_break = addr;
+        dbg_break_bank = 0xFF;
+        return 1;
+    }
+    return 0;
+}
+
 void dbg_decode_next_op(uint16_t pc) {
     char regs[32]; // PIC "A=xx X=xx Y=xx [CVNZID]" // 24
     // register state
@@ -82,78 +113,80 @@ void dbg_decode_next_op(uint16_t pc) {
         (status&FLAG_SIGN)?'N':'-', (status&FLAG_ZERO)?'Z':'-',
         (status&FLAG_INTERRUPT)?'I':'-', (status&FLAG_DECIMAL)?'D':'-');
     // decode instruction
+    char at[8], to_at[8];
+    dbg_addr(at, pc);
     uint8_t op = read6502(pc);
     const char* mne = dbg_mnemonictable[op];
     const dbg_eam mode = dbg_addrmode[op];
     switch (mode) {
         case ea_imp: {
-            printf("%04X %s                \t\t%s\n", pc, mne, regs);
+            printf("%-7s %s                \t\t%s\n", at, mne, regs);
             break;
         }
         case ea_acc: {
-            printf("%04X %s A              \t\t%s\n", pc, mne, regs);
+            printf("%-7s %s A              \t\t%s\n", at, mne, regs);
             break;
         }
         case ea_imm: {
             uint8_t val = read6502(pc+1);
-            printf("%04X %s #$%02X            \t\t%s\n", pc, mne, (int)(val), regs);
+            printf("%-7s %s #$%02X            \t\t%s\n", at, mne, (int)(val), regs);
             break;
         }
         case ea_rel: {
             int8_t val = read6502(pc+1); // NB signed int8
             uint16_t to = pc+2+val;
-            printf("%04X %s %+d -> $%04X    \t\t%s\n", pc, mne, val, (int)(to), regs);
+            printf("%-7s %s %+d -> $%s    \t\t%s\n", at, mne, val, dbg_addr(to_at, to), regs);
             break;
         }
         case ea_zp: {
             uint8_t val = read6502(pc+1);
-            printf("%04X %s $%02X            \t\t%s\n", pc, mne, (int)(val), regs);
+            printf("%-7s %s $%02X            \t\t%s\n", at, mne, (int)(val), regs);
             break;
         }
         case ea_zpx: {
             uint8_t val = read6502(pc+1);
-            printf("%04X %s $%02X,X          \t\t%s\n", pc, mne, (int)(val), regs);
+            printf("%-7s %s $%02X,X          \t\t%s\n", at, mne, (int)(val), regs);
             break;
         }
         case ea_zpy: {
             uint8_t val = read6502(pc+1);
-            printf("%04X %s $%02X,Y          \t\t%s\n", pc, mne, (int)(val), regs);
+            printf("%-7s %s $%02X,Y          \t\t%s\n", at, mne, (int)(val), regs);
             break;
         }
         case ea_abs: {
             uint8_t lo = read6502(pc+1);
             uint8_t hi = read6502(pc+2);
             uint16_t to = (hi<<8)|lo;
-            printf("%04X %s $%04X          \t\t%s\n", pc, mne, (int)(to), regs);
+            printf("%-7s %s $%s          \t\t%s\n", at, mne, dbg_addr(to_at, to), regs);
             break;
         }
         case ea_absx: {
             uint8_t lo = read6502(pc+1);
             uint8_t hi = read6502(pc+2);
             uint16_t to = (hi<<8)|lo;
-            printf("%04X %s $%04X,X        \t\t%s\n", pc, mne, (int)(to), regs);
+            printf("%-7s %s $%s,X        \t\t%s\n", at, mne, dbg_addr(to_at, to), regs);
             break;
         }
         case ea_absy: {
             uint8_t lo = read6502(pc+1);
             uint8_t hi = read6502(pc+2);
             uint16_t to = (hi<<8)|lo;
-            printf("%04X %s $%04X,Y        \t\t%s\n", pc, mne, (int)(to), regs);
+            printf("%-7s %s $%s,Y        \t\t%s\n", at, mne, dbg_addr(to_at, to), regs);
             break;
         }
         case ea_ind: {
             uint8_t val = read6502(pc+1);
-            printf("%04X %s ($%02X)          \t\t%s\n", pc, mne, (int)(val), regs);
+            printf("%-7s %s ($%02X)          \t\t%s\n", at, mne, (int)(val), regs);
             break;
         }
         case ea_indx: {
             uint8_t val = read6502(pc+1);
-            printf("%04X %s (%02X,X)         \t\t%s\n", pc, mne, (int)(val), regs);
+            printf("%-7s %s (%02X,X)         \t\t%s\n", at, mne, (int)(val), regs);
             break;
         }
         case ea_indy: {
             uint8_t val = read6502(pc+1);
-            printf("%04X %s ($%02X),Y        \t\t%s\n", pc, mne, (int)(val), regs);
+            printf("%-7s %s ($%02X),Y        \t\t%s\n", at, mne, (int)(val), regs);
             break;
         }
         default:
@@ -0,0 +1,218 @@
+// Robo Emulator - Disk Interface (Expansion Port)
+
+// A controller on the expansion port: five IO registers at $C0-$C4 and a disk ROM
+// in the first expansion bank (DISK_ROM_BANK). Sectors are 256 bytes and move
+// through the DMA engine: READ writes them to DMA_Dst and WRITE reads them from
+// DMA_Src, in the current DMA mode, one DMA cycle per byte, whole blocks at a time.
+//
+// The disk is an image file (linear 24-bit sector numbers) or a host directory.
+// For a directory, the top sector byte selects a file (1-255, sorted by name) and
+// file 0 is a generated catalog of 32-byte entries: name[24], u32 size, u32 sectors.
+// Files can be written but not created. Reads go through the host page cache,
+// with the following sectors advised for read-ahead.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "header.h"
+
+enum disk_const {
+    DISK_SECTOR    = 256,
+    DISK_AHEAD     = 64,      // sectors advised after each read (16K)
+    DISK_FILES     = 255,
+    DISK_NAME      = 24,
+    DISK_ENTRY     = 32,      // catalog entry
+};
+
+typedef struct disk_file {
+    char name[DISK_NAME];
+    uint32_t size;
+} disk_file;
+
+uint8_t DiskSec[3];                   // IO_DSK0-2: sector number (advances)
+uint8_t DiskCnt;                      // IO_DSKN: sector count (0 = 256)
+uint8_t DiskSta;                      // IO_DSKC read: enum disk_status
+uint8_t DiskFitted = 0;               // disk_open succeeded
+uint8_t DiskNoWrite = 0;              // run-ahead: a write could not be rolled back
+
+static const char* DiskPath = 0;
+static uint8_t DiskDir = 0;           // directory, not an image
+static int DiskFd = -1;               // open image, or the last file used
+static unsigned DiskFdFile = 0;       // its file number (directory)
+static disk_file* DiskFiles = 0;
+static unsigned DiskCount = 0;
+static uint8_t DiskBuf[256 * DISK_SECTOR];
+
+static int disk_cmp(const void* a, const void* b) {
+    return strcmp(((const disk_file*)a)->name, ((const disk_file*)b)->name);
+}
+
+static void disk_advise(int fd, uint32_t sector, int sequential) {
+#ifdef POSIX_FADV_WILLNEED
+    if (sequential) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fd, (off_t)sector * DISK_SECTOR, DISK_AHEAD * DISK_SECTOR, POSIX_FADV_WILLNEED);
+#else
+    (void)fd; (void)sector; (void)sequential;
+#endif
+}
+
+// regular files in the directory, sorted (names that do not fit are skipped)
+static int disk_scan() {
+    DIR* dir = opendir(DiskPath);
+    if (!dir) return 0;
+    if (DiskFd >= 0) close(DiskFd);   // file numbers may change
+    DiskFd = -1;
+    DiskFdFile = 0;
+    free(DiskFiles);
+    DiskFiles = calloc(DISK_FILES, sizeof(disk_file));
+    DiskCount = 0;
+    struct dirent* e;
+    while (DiskFiles && DiskCount < DISK_FILES && (e = readdir(dir))) {
+        char path[1024];
+        struct stat st;
+        if (e->d_name[0] == '.' || strlen(e->d_name) >= DISK_NAME) continue;
+        snprintf(path, sizeof(path), "%s/%s", DiskPath, e->d_name);
+        if (stat(path, &st) || !S_ISREG(st.st_mode)) continue;
+        strcpy(DiskFiles[DiskCount].name, e->d_name);
+        DiskFiles[DiskCount].size = (uint32_t)st.st_size;
+        DiskCount++;
+    }
+    closedir(dir);
+    if (!DiskFiles) return 0;
+    qsort(DiskFiles, DiskCount, sizeof(disk_file), disk_cmp);
+    return 1;
+}
+
+int disk_open(const char* path) {
+    struct stat st;
+    if (stat(path, &st)) {
+        printf("cannot open disk %s\n", path);
+        return 0;
+    }
+    DiskPath = path;
+    DiskDir = S_ISDIR(st.st_mode);
+    if (DiskDir) {
+        if (!disk_scan()) return 0;
+        printf("disk %s: %u files\n", path, DiskCount);
+    } else {
+        DiskFd = open(path, O_RDWR);
+        if (DiskFd < 0) DiskFd = open(path, O_RDONLY);
+        if (DiskFd < 0) {
+            printf("cannot open disk %s\n", path);
+            return 0;
+        }
+        disk_advise(DiskFd, 0, 1);
+        printf("disk %s: %lld sectors\n", path, (long long)st.st_size / DISK_SECTOR);
+    }
+    DiskSta = DiskDir ? DSK_DIR : 0;
+    DiskFitted = 1;
+    return 1;
+}
+
+void disk_close() {
+    if (DiskFd >= 0) close(DiskFd);
+    DiskFd = -1;
+    DiskFdFile = 0;
+    free(DiskFiles);
+    DiskFiles = 0;
+    DiskPath = 0;
+    DiskFitted = 0;
+}
+
+// file descriptor for a directory file (1-255), kept open while it is in use
+static int disk_file_fd(unsigned file) {
+    if (file == DiskFdFile && DiskFd >= 0) return DiskFd;
+    if (DiskFd >= 0) close(DiskFd);
+    DiskFd = -1;
+    DiskFdFile = 0;
+    if (!file || file > DiskCount) return -1;
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", DiskPath, DiskFiles[file-1].name);
+    DiskFd = open(path, O_RDWR);
+    if (DiskFd < 0) DiskFd = open(path, O_RDONLY);
+    if (DiskFd < 0) return -1;
+    DiskFdFile = file;
+    disk_advise(DiskFd, 0, 1);
+    return DiskFd;
+}
+
+// one catalog sector: 8 entries
+static void disk_catalog(uint32_t sector, uint8_t* buf) {
+    memset(buf, 0, DISK_SECTOR);
+    if (sector == 0) disk_scan();     // rescan when the catalog is read from the start
+    for (unsigned i=0; i<DISK_SECTOR/DISK_ENTRY; i++) {
+        unsigned n = sector * (DISK_SECTOR/DISK_ENTRY) + i;
+        if (n >= DiskCount) break;
+        uint8_t* e = buf + i * DISK_ENTRY;
+        uint32_t size = DiskFiles[n].size;
+        uint32_t sectors = (size + DISK_SECTOR-1) / DISK_SECTOR;
+        memcpy(e, DiskFiles[n].name, DISK_NAME);
+        for (int b=0; b<4; b++) {
+            e[DISK_NAME+b] = (uint8_t)(size >> (8*b));
+            e[DISK_NAME+4+b] = (uint8_t)(sectors >> (8*b));
+        }
+    }
+}
+
+// move `count` sectors starting at `lba` between the disk and `buf`
+static int disk_io(uint32_t lba, unsigned count, uint8_t* buf, int write) {
+    size_t len = (size_t)count * DISK_SECTOR;
+    int fd = DiskFd;
+    uint32_t sector = lba;
+    if (DiskDir) {
+        unsigned file = lba >> 16;
+        sector = lba & 0xFFFF;
+        if (file == 0) {
+            if (write) return 0;
+            for (unsigned i=0; i<count; i++) disk_catalog(sector + i, buf + i * DISK_SECTOR);
+            return 1;
+        }
+        fd = disk_file_fd(file);
+    }
+    if (fd < 0) return 0;
+    off_t at = (off_t)sector * DISK_SECTOR;
+    if (write) {
+        if (pwrite(fd, buf, len, at) != (ssize_t)len) return 0;
+        if (DiskDir && at + len > DiskFiles[(lba >> 16)-1].size) DiskFiles[(lba >> 16)-1].size = (uint32_t)(at + len);
+        return 1;
+    }
+    ssize_t got = pread(fd, buf, len, at);
+    if (got < 0) return 0;
+    memset(buf + got, 0, len - got);  // past the end of the file reads as zeros
+    disk_advise(fd, sector + count, 0);
+    return 1;
+}
+
+// IO_DSKC write: run a command to completion
+void disk_command(uint8_t cmd) {
+    unsigned count = DiskCnt ? DiskCnt : 256;
+    uint32_t lba = DiskSec[0] | DiskSec[1] << 8 | (uint32_t)DiskSec[2] << 16;
+    DiskSta &= ~DSK_ERR;
+    int ok = 0;
+    if (DiskPath && cmd == DSK_READ) {
+        ok = disk_io(lba, count, DiskBuf, 0);
+        if (ok) dma_from_host(DiskBuf, count * DISK_SECTOR);
+    } else if (DiskPath && cmd == DSK_WRITE) {
+        dma_to_host(DiskBuf, count * DISK_SECTOR);
+        ok = DiskNoWrite || disk_io(lba, count, DiskBuf, 1);
+    }
+    if (!ok) {
+        DiskSta |= DSK_ERR;
+        return;
+    }
+    lba += count;
+    DiskSec[0] = lba & 0xFF;
+    DiskSec[1] = (lba >> 8) & 0xFF;
+    DiskSec[2] = (lba >> 16) & 0xFF;
+}
+
+void disk_state(state_buf* s) {
+    state_tag(s, "DISK");
+    STATE(s, DiskSec);
+    STATE(s, DiskCnt);
+    STATE(s, DiskSta);
+}
@@ -0,0 +1,105 @@
+// Robo Emulator - DMA Microbenchmark
+//
+// Compares the DMA kernels (dma_simd.c) against the scalar kernels and
+// against the per-byte read/write cycles, for Masked, AltFill and APA runs.
+// Build with ./make_dma_bench (add -mavx2 to try AVX2).
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "header.h"
+
+void dma_interlock();
+uint8_t dma_read_cycle();
+void dma_write_cycle();
+
+enum bench_const {
+    RUNS = 20000,         // DRUN transfers of 256 bytes each
+    KSIZE = 16384,        // kernel buffer size
+    KRUNS = 2000,         // kernel passes
+};
+
+static uint8_t ksrc[KSIZE];
+static uint8_t kdst_a[KSIZE];
+static uint8_t kdst_b[KSIZE];
+
+uint8_t scanKeyCol(uint8_t col) { (void)col; return 0; }
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// set up a 256-byte RAM -> RAM transfer ($1000 -> $5000)
+static void dma_setup(uint8_t mode) {
+    write6502(0xD4, mode);      // IO_DCTL: mem -> mem, forward
+    write6502(0xD0, 0x00);      // IO_SRCL
+    write6502(0xD1, 0x10);      // IO_SRCH
+    write6502(0xD2, 0x00);      // IO_DSTL
+    write6502(0xD3, 0x50);      // IO_DSTH
+    write6502(0xD8, 0x5A);      // IO_DJMP: [TABLE]
+}
+
+static void bench_drun(const char* name, uint8_t mode) {
+    // per-byte cycles (the path IO_DRUN used before dma_bulk)
+    double t0 = now_sec();
+    for (int r=0; r<RUNS; r++) {
+        dma_setup(mode);
+        for (int i=0; i<256; i++) {
+            dma_interlock();
+            dma_read_cycle();
+            clockticks6502++;
+            dma_write_cycle();
+            clockticks6502++;
+            advance_vdp();
+        }
+    }
+    double t1 = now_sec();
+    uint8_t expect[256];
+    memcpy(expect, &MainRAM_1[0x1000], 256);
+    // bulk path
+    memset(&MainRAM_1[0x1000], 0, 256);
+    double t2 = now_sec();
+    for (int r=0; r<RUNS; r++) {
+        dma_setup(mode);
+        write6502(0xD5, 0);     // IO_DRUN: 256 bytes
+    }
+    double t3 = now_sec();
+    int same = !memcmp(expect, &MainRAM_1[0x1000], 256);
+    double mb = RUNS * 256.0 / (1024*1024);
+    printf("DRUN %-8s per-byte %8.1f MB/s   bulk %8.1f MB/s   x%.1f %s\n",
+        name, mb/(t1-t0), mb/(t3-t2), (t1-t0)/(t3-t2), same ? "" : "MISMATCH");
+}
+
+static void bench_kernel(const char* name, int merge) {
+    static const uint8_t apa[8] = { 3, 3, 6, 6, 12, 12, 24, 24 }; // 2bpp pixel masks
+    double t0 = now_sec();
+    for (int r=0; r<KRUNS; r++) {
+        if (merge) dma_merge_scalar(kdst_a, ksrc, KSIZE, 0x5A, apa);
+        else dma_masked_scalar(kdst_a, ksrc, KSIZE);
+    }
+    double t1 = now_sec();
+    for (int r=0; r<KRUNS; r++) {
+        if (merge) dma_merge(kdst_b, ksrc, KSIZE, 0x5A, apa);
+        else dma_masked(kdst_b, ksrc, KSIZE);
+    }
+    double t2 = now_sec();
+    int same = !memcmp(kdst_a, kdst_b, KSIZE);
+    double mb = (double)KRUNS * KSIZE / (1024*1024);
+    printf("kernel %-6s scalar %8.1f MB/s   %-6s %8.1f MB/s   x%.1f %s\n",
+        name, mb/(t1-t0), dma_simd_name(), mb/(t2-t1), (t1-t0)/(t2-t1), same ? "" : "MISMATCH");
+}
+
+int main() {
+    for (int i=0; i<KSIZE; i++) {
+        ksrc[i] = (i % 3) ? (uint8_t)(i * 7) : 0;     // a third are zero (transparent)
+        MainRAM_0[i] = ksrc[i];
+    }
+    bench_kernel("masked", 0);
+    bench_kernel("merge", 1);
+    bench_drun("Masked", DMA_Masked);
+    bench_drun("AltFill", DMA_AltFill);
+    bench_drun("APA", DMA_APA);
+    return 0;
+}
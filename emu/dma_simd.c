@@ -0,0 +1,86 @@
+// Robo Emulator - DMA Kernels
+
+// Vector versions of the DMA write cycle, for contiguous runs in dma_bulk().
+// Uses AVX2 when built with -mavx2, SSE2 on x86-64, otherwise scalar.
+
+#include <stdint.h>
+#include <string.h>
+#include "header.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Masked: copy src to dst, skipping zero bytes.
+void dma_masked_scalar(uint8_t* dst, const uint8_t* src, int n) {
+    for (int i=0; i<n; i++) {
+        if (src[i]) dst[i] = src[i];
+    }
+}
+
+// Merge: dst = (src & ~mask) | (table & mask), where mask repeats every 8 bytes.
+// APA pixel masks and AltFill's [FILL]/[TABLE] alternation are both merges.
+void dma_merge_scalar(uint8_t* dst, const uint8_t* src, int n, uint8_t table, const uint8_t mask[8]) {
+    for (int i=0; i<n; i++) {
+        uint8_t m = mask[i&7];
+        dst[i] = (src[i] & ~m) | (table & m);
+    }
+}
+
+void dma_masked(uint8_t* dst, const uint8_t* src, int n) {
+    int i = 0;
+#if defined(__AVX2__)
+    __m256i zero32 = _mm256_setzero_si256();
+    for (; i+32 <= n; i += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src+i));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst+i));
+        __m256i z = _mm256_cmpeq_epi8(s, zero32);               // $FF where src is zero
+        _mm256_storeu_si256((__m256i*)(dst+i), _mm256_blendv_epi8(s, d, z));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i zero16 = _mm_setzero_si128();
+    for (; i+16 <= n; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src+i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst+i));
+        __m128i z = _mm_cmpeq_epi8(s, zero16);                  // $FF where src is zero
+        _mm_storeu_si128((__m128i*)(dst+i), _mm_or_si128(_mm_and_si128(z, d), _mm_andnot_si128(z, s)));
+    }
+#endif
+    dma_masked_scalar(dst+i, src+i, n-i);
+}
+
+void dma_merge(uint8_t* dst, const uint8_t* src, int n, uint8_t table, const uint8_t mask[8]) {
+    int i = 0; // steps in multiples of 8, so mask[i&7] stays in phase
+#if defined(__AVX2__) || defined(__SSE2__)
+    int64_t m8;
+    memcpy(&m8, mask, 8);
+#endif
+#if defined(__AVX2__)
+    __m256i m32 = _mm256_set1_epi64x(m8);
+    __m256i t32 = _mm256_and_si256(_mm256_set1_epi8((char)table), m32);
+    for (; i+32 <= n; i += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src+i));
+        _mm256_storeu_si256((__m256i*)(dst+i), _mm256_or_si256(_mm256_andnot_si256(m32, s), t32));
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i m16 = _mm_set1_epi64x(m8);
+    __m128i t16 = _mm_and_si128(_mm_set1_epi8((char)table), m16);
+    for (; i+16 <= n; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src+i));
+        _mm_storeu_si128((__m128i*)(dst+i), _mm_or_si128(_mm_andnot_si128(m16, s), t16));
+    }
+#endif
+    dma_merge_scalar(dst+i, src+i, n-i, table, mask);
+}
+
+const char* dma_simd_name() {
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
@@ -941,6 +941,7 @@ void irq6502() {
 }
 
 void dbg_decode_next_op(uint16_t pc); // extern
+int dbg_at_break(uint16_t pc); // extern
 
 void exec6502(uint32_t tickcount) {
 #ifdef DEBUGGER
@@ -952,7 +953,7 @@ void exec6502(uint32_t tickcount) {
 #ifdef DEBUGGER
         if (dbg_enable) {
             old_pc = pc;
-            if (dbg_enable && pc == dbg_break) {
+            if (dbg_enable && dbg_at_break(pc)) {
                 printf("%04X breakpoint\n", pc);
                 return;
             }
@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <stddef.h>
 
 enum consts {
     VRAM_SIZE = 16384,
@@ -21,7 +22,8 @@ void exec6502(uint32_t tickcount);
 void step6502();
 void request_irq();
 void request_nmi();
-extern uint32_t clockticks6502;
+extern uint32_t clockticks6502, clockgoal6502;
+extern uint32_t instructions;
 extern uint16_t pc;
 extern uint8_t sp, a, x, y, status;
 extern uint8_t dbg_enable;
@@ -30,11 +32,31 @@ extern uint8_t pend_irq;
 
 // debugger
 extern uint16_t dbg_break;
+extern uint8_t dbg_break_bank;
 void dbg_decode_next_op(uint16_t pc);
+int dbg_at_break(uint16_t pc);
+int dbg_parse_break(const char* str);
 
 // ULA
 uint8_t read6502(uint16_t address);
 void write6502(uint16_t address, uint8_t value);
+void ula_map_bank(unsigned bank, uint8_t* mem, uint8_t writable);
+void ula_map_ram(unsigned bank);
+uint8_t ula_bank_at(uint16_t address);
+uint64_t ula_config_hash();
+extern uint8_t HwAccel;     // Booth multiplier and DMA fastload fitted
+extern uint32_t KbdReads;
+void hdma_line(uint16_t line, uint32_t at);
+enum page_map {               // 256-byte pages tracked for rewind
+    PAGE_MAIN      = 0,                 // MainRAM_0, MainRAM_1 (128 pages)
+    PAGE_BANK      = 128,               // 64 banks of 64 pages
+    PAGE_VRAM      = PAGE_BANK + 64*64, // 64 pages
+    PAGE_PAL       = PAGE_VRAM + 64,
+    PAGE_SPR       = PAGE_PAL + 1,
+    PAGE_COUNT     = PAGE_SPR + 1,
+};
+extern uint8_t PageDirty[PAGE_COUNT];
+uint8_t* ula_page(unsigned page);
 extern uint8_t VidYCmp;
 extern uint8_t VidScrH;
 extern uint8_t VidScrV;
@@ -52,9 +74,174 @@ int init_render();
 void final_render();
 void render();
 void advance_vdp();
+uint64_t vdp_vbusy_edge();
+uint64_t vdp_vblank_clk();
+uint64_t vdp_irq_clk();
+uint32_t vdp_cpu_clk(uint64_t clk);
+uint16_t vdp_hpos();
+void vdp_palette(uint8_t index);  // PAL_RAM[index] was written
+void vdp_palette_all();           // all of PAL_RAM changed
 extern uint16_t vdp_vcount; // 9-bit vertical line count
 extern uint8_t vdp_vblank;  // 1-bit latch
 extern uint8_t vdp_vbusy; // 1-bit latch (VDP is using VRAM)
+extern uint32_t vdp_frames;
+extern uint8_t vdp_present;
+extern uint8_t vdp_count;
+
+// DMA kernels
+void dma_masked(uint8_t* dst, const uint8_t* src, int n);
+void dma_merge(uint8_t* dst, const uint8_t* src, int n, uint8_t table, const uint8_t mask[8]);
+void dma_masked_scalar(uint8_t* dst, const uint8_t* src, int n);
+void dma_merge_scalar(uint8_t* dst, const uint8_t* src, int n, uint8_t table, const uint8_t mask[8]);
+const char* dma_simd_name();
+
+// Bus statistics (per frame, cleared by stats_frame)
+typedef struct bus_stats {
+    uint32_t frame;             // frame number
+    uint32_t dma_bytes[8];      // bytes moved, indexed by DMA mode (DMA_Copy..DMA_SprClr)
+    uint32_t interlock_cycles;  // CPU cycles stalled in dma_interlock
+    uint32_t ylin_cycles;       // CPU cycles stalled by IO_YLIN writes
+    uint32_t hdma_cycles;       // CPU cycles stolen by HDMA
+    uint32_t bank_switches;     // IO_BNK8/IO_BNKC writes
+    uint32_t vdp_syncs;         // advance_vdp calls
+    uint32_t io_reads[64];      // per IO port ($C0-$FF)
+    uint32_t io_writes[64];     // per IO port ($C0-$FF)
+} bus_stats;
+extern bus_stats BusStats;
+int stats_open(const char* path);  // CSV, or JSON lines if path ends in .json
+void stats_frame();
+void stats_report();
+void stats_close();
+
+// IO event log
+enum iolog_dir {
+    IOLOG_RD       = 0,
+    IOLOG_WR       = 1,
+};
+enum iolog_fmt {
+    IOLOG_VERSION  = 1,
+    IOLOG_MACHINE  = 48,     // Robo 48 (emu/)
+};
+typedef struct io_event {     // 16 bytes
+    uint32_t cycle;           // clockticks6502
+    uint16_t pc;              // PC after the operand fetch
+    uint16_t vcount;          // vdp_vcount
+    uint16_t hpos;            // vdp_hpos(): VDP clock within the line (0-567)
+    uint8_t port;             // IO address (low byte)
+    uint8_t value;
+    uint8_t dir;              // enum iolog_dir
+    uint8_t pad;
+} io_event;
+typedef struct iolog_header { // 16 bytes, followed by `count` io_event
+    char magic[6];            // "IOLOG"
+    uint8_t version;
+    uint8_t machine;
+    uint32_t count;
+    uint32_t lost;            // older events overwritten in the ring
+} iolog_header;
+extern uint64_t IoLogMask;
+void iolog_event(uint8_t port, uint8_t value, uint8_t dir);
+uint64_t iolog_ports(const char* spec);
+int iolog_dump(const char* path);
+
+// Save states
+enum state_mode {
+    STATE_SIZE     = 0,       // count bytes only (buf is 0)
+    STATE_SAVE     = 1,
+    STATE_CHECK    = 2,       // validate a saved state without loading it
+    STATE_LOAD     = 3,
+};
+enum state_skip {             // partial states, for rewind
+    STATE_ALL      = 0,
+    STATE_NO_FB    = 1,       // without the framebuffer
+    STATE_NO_RAM   = 2,       // without RAM, VRAM, palette and sprites
+    STATE_REGS     = 3,       // registers, counters and latches only
+};
+typedef struct state_buf {
+    uint8_t* buf;
+    size_t pos, cap;
+    uint8_t mode;             // enum state_mode
+    uint8_t fail;
+    uint8_t skip;             // enum state_skip
+} state_buf;
+void state_bytes(state_buf* s, void* p, size_t n);
+void state_local(state_buf* s, void* p, size_t n);
+void state_tag(state_buf* s, const char tag[4]);
+#define STATE(s,v) state_bytes((s), &(v), sizeof(v))
+void ula_state(state_buf* s);
+void vdp_state(state_buf* s);
+size_t state_size();
+size_t state_save(uint8_t* buf, size_t cap);
+int state_load(const uint8_t* buf, size_t len);
+size_t state_size_part(uint8_t skip);
+size_t state_save_part(uint8_t* buf, size_t cap, uint8_t skip);
+int state_load_part(const uint8_t* buf, size_t len, uint8_t skip);
+int state_save_file(const char* path);
+int state_load_file(const char* path);
+int state_save_boot(const char* path, uint64_t key);
+int state_load_boot(const char* path, uint64_t key);
+
+// Rewind
+int rewind_init(size_t budget);       // bytes of history (0 = off)
+void rewind_reset();                  // after loading a state: history restarts here
+void rewind_capture();                // once per frame, between CPU steps
+int rewind_step();                    // back to the previous capture; 0 at the oldest
+uint32_t rewind_frames();
+
+// Input recording and replay
+enum input_mode {
+    INPUT_LIVE     = 0,
+    INPUT_RECORD   = 1,
+    INPUT_REPLAY   = 2,
+};
+uint8_t input_mode();
+uint8_t input_key(uint8_t col);       // IO_KEYB read
+int input_record(const char* path);   // from the current state
+int input_replay(const char* path);   // loads the recorded state
+int input_replay_done();
+uint64_t input_state_hash();
+int input_close();
+
+// Input-to-photon latency
+enum lat_state {              // one key press in flight
+    LAT_OFF        = 0,
+    LAT_IDLE       = 1,
+    LAT_KEY        = 2,       // key event polled
+    LAT_SCANNED    = 3,       // ROM read the key
+    LAT_WRITTEN    = 4,       // VRAM written since
+    LAT_FRAMED     = 5,       // frame being rendered
+};
+extern uint8_t LatState;
+int lat_open();
+void lat_key(uint32_t timestamp);     // SDL_KEYDOWN
+void lat_scan(uint8_t col, uint8_t value);
+void lat_vram();
+void lat_render();                    // render() start, and after SDL_RenderPresent
+void lat_report();
+
+// Disk interface (expansion port)
+enum disk_port {
+    DISK_ROM_BANK  = 4,       // first expansion bank
+};
+enum disk_cmd {
+    DSK_READ       = 1,       // sectors -> DMA_Dst
+    DSK_WRITE      = 2,       // DMA_Src -> sectors
+};
+enum disk_status {
+    DSK_ERR        = 0x01,    // last command failed
+    DSK_DIR        = 0x08,    // host directory (top sector byte is a file)
+};
+extern uint8_t DiskSec[3];
+extern uint8_t DiskCnt;
+extern uint8_t DiskSta;
+extern uint8_t DiskFitted;            // a disk is open (else $C0-$C4 are open bus)
+extern uint8_t DiskNoWrite;           // run-ahead: WRITE succeeds without writing
+int disk_open(const char* path);      // image file or directory
+void disk_close();
+void disk_command(uint8_t cmd);
+void disk_state(state_buf* s);
+void dma_from_host(const uint8_t* buf, unsigned n);   // DMA write cycles to DMA_Dst
+void dma_to_host(uint8_t* buf, unsigned n);           // DMA read cycles from DMA_Src
 
 // SDL
 uint8_t scanKeyCol(uint8_t);
@@ -78,6 +265,7 @@ enum vena_bits {
     VENA_VSync     = 0x80,
     VENA_VCmp      = 0x40,
     VENA_HSync     = 0x20,
+    VENA_HDMA_En   = 0x10,
     VENA_Pwr_LED   = 0x08,
     VENA_Caps_LED  = 0x04,
     VENA_Spr_En    = 0x02,
@@ -0,0 +1,166 @@
+// Robo Emulator - Input Recording and Replay
+
+// All keyboard input goes through input_key() (IO_KEYB reads). A recording holds
+// the machine state it started from and one event per change in a column's value,
+// against the keyboard read (and CPU cycle) at which the ROM sampled it.
+// A replay loads that state and feeds the same values to the same reads, so it
+// is bit-exact: the cycle of each event is checked to catch a desync.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "header.h"
+
+typedef struct input_event {  // 12 bytes
+    uint32_t read;            // keyboard reads since the recording started
+    uint32_t cycle;           // clockticks6502
+    uint8_t col;              // KbdCol
+    uint8_t value;
+    uint8_t pad[2];
+} input_event;
+
+typedef struct input_header { // 24 bytes, followed by the state and the events
+    char magic[8];            // "ROBOINP"
+    uint32_t version;
+    uint32_t frames;          // frames recorded
+    uint32_t count;           // events
+    uint32_t state;           // bytes of state
+} input_header;
+
+enum input_fmt {
+    INPUT_VERSION  = 1,
+    INPUT_COLS     = 16,      // 4-bit KbdCol
+};
+
+static uint8_t InputMode = INPUT_LIVE;
+static const char* InputPath = 0;
+static input_event* InputLog = 0;
+static uint32_t InputCount = 0;       // events recorded or loaded
+static uint32_t InputCap = 0;
+static uint32_t InputNext = 0;        // replay: next event
+static uint32_t InputReads = 0;       // keyboard reads since the start
+static uint32_t InputFrame0 = 0;      // BusStats.frame at the start
+static uint32_t InputFrames = 0;      // replay: frames to run
+static uint8_t InputCol[INPUT_COLS];  // last value of each column
+static uint8_t InputSeen[INPUT_COLS]; // record: column read at least once
+static uint8_t InputDesync = 0;
+static uint8_t* InputState = 0;       // record: state at the start
+static size_t InputStateLen = 0;
+
+uint8_t input_mode() {
+    return InputMode;
+}
+
+// value of keyboard column `col` for an IO_KEYB read
+uint8_t input_key(uint8_t col) {
+    col &= INPUT_COLS-1;
+    uint32_t read = InputReads++;
+    if (InputMode == INPUT_REPLAY) {
+        while (InputNext < InputCount && InputLog[InputNext].read == read) {
+            input_event* e = &InputLog[InputNext++];
+            if ((e->cycle != clockticks6502 || e->col != col) && !InputDesync) {
+                printf("replay desync at read %u: cycle %u (recorded %u)\n", read, clockticks6502, e->cycle);
+                InputDesync = 1;
+            }
+            InputCol[e->col & (INPUT_COLS-1)] = e->value;
+        }
+        return InputCol[col];
+    }
+    uint8_t value = scanKeyCol(col);
+    if (InputMode == INPUT_RECORD && (!InputSeen[col] || InputCol[col] != value)) {
+        if (InputCount == InputCap) {
+            uint32_t cap = InputCap ? InputCap*2 : 4096;
+            input_event* log = realloc(InputLog, cap * sizeof(input_event));
+            if (!log) return value;
+            InputLog = log;
+            InputCap = cap;
+        }
+        input_event e = { read, clockticks6502, col, value, {0} };
+        InputLog[InputCount++] = e;
+        InputSeen[col] = 1;
+        InputCol[col] = value;
+    }
+    return value;
+}
+
+// start recording from the current state (written to `path` by input_close)
+int input_record(const char* path) {
+    InputStateLen = state_size();
+    InputState = malloc(InputStateLen);
+    if (!InputState) return 0;
+    InputStateLen = state_save(InputState, InputStateLen);
+    InputMode = INPUT_RECORD;
+    InputPath = path;
+    InputCount = InputReads = 0;
+    InputFrame0 = BusStats.frame;
+    memset(InputSeen, 0, sizeof(InputSeen));
+    return 1;
+}
+
+// load the recording's state and replay its input
+int input_replay(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+    input_header hdr;
+    uint8_t* state = 0;
+    int ok = fread(&hdr, sizeof(hdr), 1, f) == 1 && !memcmp(hdr.magic, "ROBOINP", 8) && hdr.version == INPUT_VERSION;
+    if (ok) {
+        state = malloc(hdr.state);
+        InputLog = malloc((size_t)hdr.count * sizeof(input_event) + 1);
+        ok = state && InputLog && fread(state, 1, hdr.state, f) == hdr.state &&
+             fread(InputLog, sizeof(input_event), hdr.count, f) == hdr.count &&
+             state_load(state, hdr.state);
+    }
+    fclose(f);
+    free(state);
+    if (!ok) {
+        free(InputLog);
+        InputLog = 0;
+        return 0;
+    }
+    InputMode = INPUT_REPLAY;
+    InputPath = path;
+    InputCount = InputCap = hdr.count;
+    InputNext = InputReads = 0;
+    InputFrame0 = BusStats.frame;
+    InputFrames = hdr.frames;
+    memset(InputCol, 0, sizeof(InputCol));
+    return 1;
+}
+
+// replay: all recorded frames have run
+int input_replay_done() {
+    return InputMode == INPUT_REPLAY && BusStats.frame - InputFrame0 >= InputFrames;
+}
+
+// FNV-1a hash of the whole machine state, to compare replays
+uint64_t input_state_hash() {
+    size_t size = state_size();
+    uint8_t* buf = malloc(size);
+    uint64_t h = 0xCBF29CE484222325ull;
+    if (!buf) return 0;
+    size = state_save(buf, size);
+    for (size_t i=0; i<size; i++) h = (h ^ buf[i]) * 0x100000001B3ull;
+    free(buf);
+    return h;
+}
+
+// recording: write the file, with the state saved when recording started
+int input_close() {
+    int ok = 1;
+    if (InputMode == INPUT_RECORD && InputState) {
+        input_header hdr = { "ROBOINP", INPUT_VERSION, BusStats.frame - InputFrame0, InputCount, (uint32_t)InputStateLen };
+        FILE* f = fopen(InputPath, "wb");
+        ok = f && fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+             fwrite(InputState, 1, InputStateLen, f) == InputStateLen &&
+             fwrite(InputLog, sizeof(input_event), InputCount, f) == InputCount;
+        if (f && fclose(f)) ok = 0;
+        printf("recorded %u frames, %u input events to %s\n", hdr.frames, InputCount, InputPath);
+    }
+    free(InputLog);
+    free(InputState);
+    InputLog = 0;
+    InputState = 0;
+    InputMode = INPUT_LIVE;
+    return ok;
+}
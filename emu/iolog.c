@@ -0,0 +1,74 @@
+// Robo Emulator - IO Event Log
+
+// Binary ring buffer of IO accesses, cheap enough to leave on at full speed.
+// ula.c calls iolog_event() for the ports selected in IoLogMask; iolog_dump()
+// writes the buffer oldest-first, for the decoder in iolog_dump.c.
+
+#include <stdio.h>
+#include <string.h>
+#include "header.h"
+
+enum iolog_const {
+    IOLOG_SIZE = 1 << 16,     // events in the ring (power of 2), 1MB
+};
+
+uint64_t IoLogMask = 0;               // bit per IO port (address & 63), 0 = off
+static io_event IoLog[IOLOG_SIZE];
+static uint32_t IoLogCount = 0;       // events logged (the ring keeps the last IOLOG_SIZE)
+
+// The VDP has been caught up by the caller, so vcount/hpos are current.
+void iolog_event(uint8_t port, uint8_t value, uint8_t dir) {
+    io_event* e = &IoLog[IoLogCount & (IOLOG_SIZE-1)];
+    e->cycle = clockticks6502;
+    e->pc = pc;
+    e->vcount = vdp_vcount;
+    e->hpos = vdp_hpos();
+    e->port = port;
+    e->value = value;
+    e->dir = dir;
+    e->pad = 0;
+    IoLogCount++;
+}
+
+// Parse a port list: "all", or hex ports and ranges such as "D0-D8,F2".
+uint64_t iolog_ports(const char* spec) {
+    if (!strcmp(spec, "all")) return ~(uint64_t)0;
+    uint64_t mask = 0;
+    while (*spec) {
+        unsigned first, last;
+        int len = 0;
+        if (sscanf(spec, "%x-%x%n", &first, &last, &len) < 2) {
+            if (sscanf(spec, "%x%n", &first, &len) < 1) break;
+            last = first;
+        }
+        for (unsigned p=first; p<=last && p<=0xFF; p++) mask |= (uint64_t)1 << (p & 63);
+        spec += len;
+        if (*spec == ',') spec++;
+    }
+    return mask;
+}
+
+int iolog_dump(const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        perror("fopen");
+        return 0;
+    }
+    uint32_t n = IoLogCount < IOLOG_SIZE ? IoLogCount : IOLOG_SIZE;
+    iolog_header hdr;
+    memcpy(hdr.magic, "IOLOG", 6);
+    hdr.version = IOLOG_VERSION;
+    hdr.machine = IOLOG_MACHINE;
+    hdr.count = n;
+    hdr.lost = IoLogCount - n;
+    fwrite(&hdr, sizeof(hdr), 1, f);
+    // oldest first: once wrapped, the ring starts at IoLogCount
+    uint32_t start = (IoLogCount - n) & (IOLOG_SIZE-1);
+    uint32_t first = IOLOG_SIZE - start;
+    if (first > n) first = n;
+    fwrite(&IoLog[start], sizeof(io_event), first, f);
+    fwrite(&IoLog[0], sizeof(io_event), n - first, f);
+    fclose(f);
+    printf("iolog: wrote %u events to %s\n", n, path);
+    return 1;
+}
@@ -0,0 +1,80 @@
+// Robo Emulator - IO Log Decoder
+//
+// Prints an IO event log written by iolog_dump() (-iolog PORTS FILE, F11 or exit),
+// for either machine. Usage: iolog_dump FILE [PORTS]
+// Build with ./make_iolog_dump
+
+#include <stdio.h>
+#include <string.h>
+#include "header.h"
+
+// Robo 48 ports $C0-$FF (see emu/ula.c)
+static const char* names48[64] = {
+    [0x10] = "SRCL", "SRCH", "DSTL", "DSTH", "DCTL", "DRUN", "FILL", "DDRW",
+    [0x18] = "DJMP", "AINC", "BNK8", "BNKC", "HDMA", 0, "KEYB", "MULW",
+    [0x20] = "TON0", "PCH0", "VOL0", "TON1", "PCH1", "VOL1", "TON2", "PCH2",
+    [0x28] = "VOL2", "TON3", "PCH3", "VOL3", "GP0R", "GP1R", "GP2R", "GP3R",
+    [0x30] = "YLIN", "YCMP", "SCRH", "SCRV", "FINH", "FINV", "VCTL", "VENA",
+    [0x38] = "VSTA", "VMAP", "VTAB", "VBNK", "PALA", "PALD", "SPRA", "SPRD",
+};
+
+// Robo-8 ports $F8-$FF (see robo-8/emu/ula.c)
+static const char* names8[64] = {
+    [0x38] = "DATA", "KEYB", "LINE", "PSGF", "PAL1", "PAL2", "VPGC", "VCTL",
+};
+
+// same syntax as iolog_ports() in iolog.c
+static uint64_t parse_ports(const char* spec) {
+    if (!strcmp(spec, "all")) return ~(uint64_t)0;
+    uint64_t mask = 0;
+    while (*spec) {
+        unsigned first, last;
+        int len = 0;
+        if (sscanf(spec, "%x-%x%n", &first, &last, &len) < 2) {
+            if (sscanf(spec, "%x%n", &first, &len) < 1) break;
+            last = first;
+        }
+        for (unsigned p=first; p<=last && p<=0xFF; p++) mask |= (uint64_t)1 << (p & 63);
+        spec += len;
+        if (*spec == ',') spec++;
+    }
+    return mask;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: iolog_dump FILE [PORTS]\n");
+        return 1;
+    }
+    uint64_t mask = argc > 2 ? parse_ports(argv[2]) : ~(uint64_t)0;
+    FILE* f = fopen(argv[1], "rb");
+    if (!f) {
+        perror("fopen");
+        return 1;
+    }
+    iolog_header hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, "IOLOG", 6) || hdr.version != IOLOG_VERSION) {
+        fprintf(stderr, "%s: not an IO log (version %d)\n", argv[1], IOLOG_VERSION);
+        fclose(f);
+        return 1;
+    }
+    const char** names = (hdr.machine == 8) ? names8 : names48;
+    printf("; Robo %d, %u events (%u older events lost)\n", hdr.machine, hdr.count, hdr.lost);
+    printf(";     cycle    +delta  line:hpos  pc    dir port       value\n");
+    io_event e;
+    uint32_t prev = 0;
+    int first = 1;
+    for (uint32_t i=0; i<hdr.count && fread(&e, sizeof(e), 1, f) == 1; i++) {
+        if (!(mask & ((uint64_t)1 << (e.port & 63)))) continue;
+        uint32_t delta = first ? 0 : e.cycle - prev;
+        const char* name = names[e.port & 63];
+        printf("%11u +%-8u  %3u:%-4u  %04X  %s  $%02X %-4s  %s $%02X\n",
+            e.cycle, delta, e.vcount, e.hpos, e.pc,
+            e.dir == IOLOG_WR ? "W" : "R", e.port, name ? name : "",
+            e.dir == IOLOG_WR ? "<-" : "->", e.value);
+        prev = e.cycle;
+        first = 0;
+    }
+    fclose(f);
+    return 0;
+}
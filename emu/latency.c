@@ -0,0 +1,136 @@
+// Robo Emulator - Input-to-Photon Latency
+
+// With -latency, each key press is followed through four stages:
+//   queue     SDL event timestamp -> polled by the main loop
+//   scan      polled -> first IO_KEYB read that sees a new key bit (the ROM's scan)
+//   emulate   scan -> first VRAM write after it, and the frame rendered after that
+//   present   render() starts -> SDL_RenderPresent returns
+// Host times are wall clock; the emulated cycles for scan and emulate are kept too.
+// One press is measured at a time; presses that never reach VRAM time out.
+
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "header.h"
+
+enum lat_const {
+    LAT_MAX        = 4096,    // samples kept
+    LAT_TIMEOUT    = 2000,    // ms without a VRAM write: not a visible key
+    LAT_BUCKETS    = 9,       // histogram: <1, <2, <4 ... <128, 128+ ms
+};
+
+enum lat_stage { LAT_QUEUE, LAT_SCAN, LAT_EMULATE, LAT_PRESENT, LAT_TOTAL, LAT_STAGES };
+
+static const char* lat_stage_name[LAT_STAGES] = { "queue", "scan", "emulate", "present", "total" };
+
+typedef struct lat_sample {
+    float ms[LAT_STAGES];
+    uint32_t scan_cycles;     // emulated: poll -> scan
+    uint32_t write_cycles;    // emulated: scan -> VRAM write
+} lat_sample;
+
+uint8_t LatState = LAT_OFF;
+static uint8_t LatCol[16];            // last value read from each column
+static uint32_t LatEvent;             // SDL event timestamp (ms)
+static uint64_t LatPoll, LatScan, LatFrame;   // host clock
+static uint32_t LatPollClk, LatScanClk;       // clockticks6502
+static lat_sample LatCur;
+static lat_sample* LatSamples = 0;
+static uint32_t LatCount = 0;
+
+static double lat_ms(uint64_t from, uint64_t to) {
+    return (double)(to - from) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+int lat_open() {
+    LatSamples = calloc(LAT_MAX, sizeof(lat_sample));
+    if (!LatSamples) return 0;
+    LatState = LAT_IDLE;
+    return 1;
+}
+
+// SDL_KEYDOWN (not repeats): start a measurement if none is in flight
+void lat_key(uint32_t timestamp) {
+    if (LatState == LAT_OFF || (LatState != LAT_IDLE && SDL_GetTicks() - LatEvent < LAT_TIMEOUT)) return;
+    LatEvent = timestamp;
+    LatPoll = SDL_GetPerformanceCounter();
+    LatPollClk = clockticks6502;
+    LatCur.ms[LAT_QUEUE] = (float)(SDL_GetTicks() - timestamp);
+    LatState = LAT_KEY;
+}
+
+// IO_KEYB read
+void lat_scan(uint8_t col, uint8_t value) {
+    uint8_t pressed = value & ~LatCol[col & 15];
+    LatCol[col & 15] = value;
+    if (LatState == LAT_KEY && pressed) {
+        LatScan = SDL_GetPerformanceCounter();
+        LatScanClk = clockticks6502;
+        LatCur.ms[LAT_SCAN] = lat_ms(LatPoll, LatScan);
+        LatCur.scan_cycles = LatScanClk - LatPollClk;
+        LatState = LAT_SCANNED;
+    }
+}
+
+// VRAM write (only called in LAT_SCANNED)
+void lat_vram() {
+    LatCur.write_cycles = clockticks6502 - LatScanClk;
+    LatState = LAT_WRITTEN;
+}
+
+// render() begins (LAT_WRITTEN) or SDL_RenderPresent returned (LAT_FRAMED)
+void lat_render() {
+    uint64_t now = SDL_GetPerformanceCounter();
+    if (LatState == LAT_WRITTEN) {
+        LatFrame = now;
+        LatCur.ms[LAT_EMULATE] = lat_ms(LatScan, now);
+        LatState = LAT_FRAMED;
+    } else if (LatState == LAT_FRAMED) {
+        LatCur.ms[LAT_PRESENT] = lat_ms(LatFrame, now);
+        LatCur.ms[LAT_TOTAL] = LatCur.ms[LAT_QUEUE] + lat_ms(LatPoll, now);
+        if (LatCount < LAT_MAX) LatSamples[LatCount++] = LatCur;
+        LatState = LAT_IDLE;
+    }
+}
+
+static int lat_cmp(const void* a, const void* b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+void lat_report() {
+    if (LatState == LAT_OFF) return;
+    printf("input latency: %u key presses\n", LatCount);
+    if (!LatCount) return;
+    float* v = malloc(LatCount * sizeof(float));
+    if (!v) return;
+    printf("  stage       min     p50     p95     max     avg  ms   |");
+    for (int b=0; b<LAT_BUCKETS-1; b++) printf(" <%-3d", 1 << b);
+    printf(" more\n");
+    for (int st=0; st<LAT_STAGES; st++) {
+        uint32_t hist[LAT_BUCKETS] = {0};
+        double sum = 0;
+        for (uint32_t i=0; i<LatCount; i++) {
+            float ms = LatSamples[i].ms[st];
+            int b = 0;
+            while (b < LAT_BUCKETS-1 && ms >= (float)(1 << b)) b++;
+            hist[b]++;
+            v[i] = ms;
+            sum += ms;
+        }
+        qsort(v, LatCount, sizeof(float), lat_cmp);
+        printf("  %-8s %7.2f %7.2f %7.2f %7.2f %7.2f      |", lat_stage_name[st],
+            v[0], v[LatCount/2], v[(LatCount*95)/100], v[LatCount-1], sum / LatCount);
+        for (int b=0; b<LAT_BUCKETS; b++) printf(" %4u", hist[b]);
+        printf("\n");
+    }
+    double scan = 0, write = 0;
+    for (uint32_t i=0; i<LatCount; i++) {
+        scan += LatSamples[i].scan_cycles;
+        write += LatSamples[i].write_cycles;
+    }
+    // CPU at 17.734475 MHz / 9
+    printf("  emulated: scan %.2f ms, scan to VRAM write %.2f ms (average)\n",
+        scan / LatCount * 9000.0 / 17734475.0, write / LatCount * 9000.0 / 17734475.0);
+    free(v);
+}
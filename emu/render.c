@@ -41,6 +41,9 @@ static uint8_t vdp_vtile = 0; // 8-bit vertical tile counter (0-24)
 static uint8_t vdp_vborder = 0;  // 1-bit latch
 uint8_t vdp_vblank = 0;  // 1-bit latch (visible to ula.c)
 uint8_t vdp_vram_lock = 0; // 1-bit latch (VDP is using VRAM)
+uint32_t vdp_frames = 0;   // frames completed (VBlank), including run-ahead frames
+uint8_t vdp_present = 1;   // present the frame at VBlank
+uint8_t vdp_count = 1;     // count the frame in BusStats (not run-ahead frames)
 
 // [00000000][00000000][00000000] -- fetch tile         (load low)
 // [00000000][00000000][00000000]
@@ -95,6 +98,7 @@ int init_render() {
         VRAM[i] = i;
         PAL_RAM[i&(PAL_SIZE-1)] = i;
     }
+    vdp_palette_all();
     return 1;
 }
 
@@ -108,9 +112,10 @@ void final_render() {
 void render() {
     void* pixels;
     int pitch;
-    if (SDL_LockTexture(texture, NULL, &pixels, &pitch) != 0) {
+    if (!texture || SDL_LockTexture(texture, NULL, &pixels, &pitch) != 0) {   // no window when headless
         return;
     }
+    if (LatState == LAT_WRITTEN) lat_render();
 
     // render the framebuffer.
     // memcpy(pixels, FB, sizeof(FB));
@@ -142,19 +147,337 @@ void render() {
     SDL_RenderClear(renderer);
     SDL_RenderCopy(renderer, texture, NULL, NULL);
     SDL_RenderPresent(renderer);
+    if (LatState == LAT_FRAMED) lat_render();
+}
+
+// VRAM busy pattern: VBusy rises at the early line start of the last line
+// and falls at the end of the last visible line. The fetch schedule doesn't
+// depend on VCTL, so one pattern (frame positions in VDP clocks) covers all modes.
+enum vdp_timing {
+    vdp_line_clks  = 568,                          // PAL: 71 tiles of 8 clocks
+    vdp_frame_clks = 568*312,                      // 312 lines
+    vdp_busy_on    = 311*568 + ((40+9+13+9-2)<<3), // early line start, line 311
+    vdp_busy_off   = 224*568,                      // end of visible lines
+    vdp_vblank_on  = (224+32)*568,                 // start of VBLANK
+    vdp_vsync_irq  = 224*568,                      // VSync interrupt
+    vdp_hdma_at    = (40+9)<<3,                    // HDMA runs at the start of HBLANK
+};
+
+// VDP clock at which the VDP next reaches frame position `at`.
+static uint64_t vdp_next_clk(int64_t at) {
+    int64_t pos = vdp_vcount*vdp_line_clks + ((vdp_hcount << 3) | vdp_hsub);
+    int64_t dist = at - pos;
+    if (dist <= 0) dist += vdp_frame_clks;         // next frame
+    return vdp_clk + dist;
+}
+
+// VDP clock at which vdp_vbusy next changes (rises if clear, falls if set).
+uint64_t vdp_vbusy_edge() {
+    return vdp_next_clk(vdp_vbusy ? vdp_busy_off : vdp_busy_on);
+}
+
+// VDP clock at which the next VBLANK starts.
+uint64_t vdp_vblank_clk() {
+    return vdp_next_clk(vdp_vblank_on);
+}
+
+// VDP clock at which the VDP next raises an interrupt (UINT64_MAX if none enabled).
+uint64_t vdp_irq_clk() {
+    uint64_t clk = UINT64_MAX;
+    if (VidEna & VENA_VSync) clk = vdp_next_clk(vdp_vsync_irq);
+    if ((VidEna & (VENA_HDMA_En|VENA_HSync)) == (VENA_HDMA_En|VENA_HSync)) {
+        // HDMA may raise HSync in any HBLANK
+        int dist = vdp_hdma_at - ((vdp_hcount << 3) | vdp_hsub);
+        if (dist <= 0) dist += vdp_line_clks;
+        if (vdp_clk + dist < clk) clk = vdp_clk + dist;
+    }
+    return clk;
+}
+
+// First CPU cycle at which advance_vdp() will have reached VDP clock `clk`.
+uint32_t vdp_cpu_clk(uint64_t clk) {
+    return (uint32_t)((clk*2 + 8) / 9);            // ceil(clk * 2/9), see advance_vdp
+}
+
+// VDP clock within the current line (0-567), for the IO log.
+uint16_t vdp_hpos() {
+    return (vdp_hcount << 3) | vdp_hsub;
+}
+
+// Save state: counters, latches, shift registers and the framebuffer.
+void vdp_state(state_buf* s) {
+    uint32_t span = (uint32_t)(FBspan - FB);
+    state_tag(s, "VDP ");
+    STATE(s, vdp_clk);
+    STATE(s, bg_ld_tl);
+    STATE(s, bg_ld_al);
+    STATE(s, bg_ld_gfx0);
+    STATE(s, bg_ld_gfx1);
+    STATE(s, bg_shift);
+    STATE(s, bg_attr_del);
+    STATE(s, bg_attr);
+    STATE(s, bg_pixel);
+    STATE(s, vdp_hcount);
+    STATE(s, vdp_hsub);
+    STATE(s, vdp_htile);
+    STATE(s, vdp_hborder);
+    STATE(s, vdp_hblank);
+    STATE(s, vdp_hbusy);
+    STATE(s, vdp_vbusy);
+    STATE(s, vdp_vcount);
+    STATE(s, vdp_vsub);
+    STATE(s, vdp_vtile);
+    STATE(s, vdp_vborder);
+    STATE(s, vdp_vblank);
+    STATE(s, vdp_vram_lock);
+    STATE(s, FBcol);
+    STATE(s, FBrow);
+    state_local(s, &span, sizeof(span));
+    if (s->mode >= STATE_CHECK && span > (uint32_t)(fb_width*fb_height)) s->fail = 1;
+    if (s->mode == STATE_LOAD && !s->fail) {
+        FBspan = FB + span;
+        vdp_palette_all();        // PAL_RAM was loaded by ula_state
+    }
+    if (s->skip & STATE_NO_FB) return;
+    state_tag(s, "FB  ");
+    STATE(s, FB);
+}
+
+// palette byte [IIRRGGBB] to ARGB, in colour and with the colorburst off (VCTL_GREY)
+static uint32_t PalLUT[2][256];
+// PAL_RAM resolved through PalLUT (kept current by vdp_palette)
+static uint32_t PalARGB[2][PAL_SIZE];
+// graphics byte to its pixels in shifter order: four 2bpp pixels, or two 4bpp pixels doubled
+static uint8_t TileRow[2][256][4];
+
+// (also fills TileRow, which does not depend on PAL_RAM)
+static void vdp_palette_lut() {
+    static const uint8_t chroma[4] = {0x00,0x60,0xB0,0xF0}; // 0.....6....B...F
+    static const uint8_t luma[4] = {0x05,0x09,0x0C,0x0F};   // .....5...9..C..F
+    for (int px=0; px<256; px++) {
+        uint32_t red = chroma[(px>>4)&3] | luma[px>>6]; // red
+        uint32_t green = chroma[(px>>2)&3] | luma[px>>6]; // green
+        uint32_t blue = chroma[(px>>0)&3] | luma[px>>6]; // blue
+        uint32_t grey = (red*77 + green*150 + blue*29) >> 8; // luminance only
+        PalLUT[0][px] = 0xFF000000 | (red<<16) | (green<<8) | blue;
+        PalLUT[1][px] = 0xFF000000 | (grey<<16) | (grey<<8) | grey;
+        for (int i=0; i<4; i++) {
+            TileRow[0][px][i] = (px >> (6-2*i)) & 3;
+            TileRow[1][px][i] = (px >> (4-4*(i>>1))) & 15;
+        }
+    }
+}
+
+// PAL_RAM[index] was written (IO_PALD, DMA_Palette)
+void vdp_palette(uint8_t index) {
+    if (!PalLUT[0][0]) vdp_palette_lut();
+    index &= PAL_SIZE-1;
+    PalARGB[0][index] = PalLUT[0][PAL_RAM[index]];
+    PalARGB[1][index] = PalLUT[1][PAL_RAM[index]];
+}
+
+// all of PAL_RAM changed (reset, state load)
+void vdp_palette_all() {
+    for (int i=0; i<PAL_SIZE; i++) vdp_palette(i);
+}
+
+// output the latched pixel (display area)
+static void vdp_pixel() {
+    uint8_t text_col;
+    if (VidCtl & VCTL_16COL) {
+        text_col = ((bg_pixel&2)<<3) | ((bg_pixel&1) ? (bg_attr&15) : (bg_attr>>4)); // 16-color mode.
+    } else {
+        text_col = ((bg_attr&14)<<1) | bg_pixel; // 4-color mode (8-palettes)
+    }
+    if (FBrow < fb_height && FBcol < fb_width) { // safety check
+        int coord = ((fb_vbord+FBrow) * fb_width) + fb_hbord + FBcol;
+        FB[coord] = PalARGB[(VidCtl & VCTL_GREY) != 0][text_col];
+        FBcol++;
+    }
+}
+
+// A whole tile (8 clocks from vdp_hsub 0) in one step: the same VRAM fetches,
+// shifter loads and pixels as eight clocks of the per-clock path in advance_vdp.
+// Nothing the VDP reads can change within the tile, since writes sync first.
+static void vdp_tile(uint16_t bpp, uint32_t bpp_shift, uint8_t bpp_mask) {
+    int fetch = vdp_vbusy && vdp_hbusy;
+    int Vshift = 6+(NameSize>>2); // 1 + 5-8 bits (32,64,128,256) (top 2 bits of NameSize are width)
+    uint16_t name = (NameBase<<8)|(vdp_vtile<<Vshift)|(vdp_htile<<1);
+    if (fetch) bg_ld_tl = VRAM[name]; // TILE (hsub 0)
+    uint32_t shift0 = (bg_shift << 2) | bg_ld_gfx0; // hsub 0 load
+    bg_attr = bg_attr_del;
+    bg_attr_del = bg_ld_al;
+    uint32_t shift4 = (shift0 << 8) | bg_ld_gfx1; // hsub 4 load (before the hsub 6 fetch)
+    if (fetch) {
+        bg_ld_al = VRAM[name|1]; // ATTRIBS (hsub 2)
+        // XXX assumes tiles begin at $0000
+        uint16_t addr = (bg_ld_tl<<4) | (vdp_vsub << 1);
+        if (!(VidCtl & VCTL_16COL)) addr |= (bg_ld_al&1) << 12; // extra bit in 4-color mode
+        bg_ld_gfx0 = VRAM[addr];   // GFX0 (hsub 4)
+        bg_ld_gfx1 = VRAM[addr|1]; // GFX1 (hsub 6)
+    }
+    bg_shift = shift4 << 6;
+    if (vdp_vborder || vdp_hborder) return;
+    if (FBrow >= fb_height || FBcol + 8 > fb_width) {
+        for (int sub=0; sub<8; sub++) {
+            uint32_t at = sub < 4 ? shift0 << (sub*2) : shift4 << ((sub-4)*2);
+            if ((sub & bpp) == 0) bg_pixel = (at >> bpp_shift) & bpp_mask;
+            vdp_pixel();
+        }
+        return;
+    }
+    // 8 pixels: the bytes loaded in the previous tile, now at shifter bits 21-6
+    uint32_t at = shift0 >> 2;
+    uint8_t pixel[8];
+    memcpy(pixel, TileRow[bpp][(at >> 14) & 0xFF], 4);
+    memcpy(pixel+4, TileRow[bpp][(at >> 6) & 0xFF], 4);
+    bg_pixel = pixel[7];
+    uint32_t* out = &FB[((fb_vbord+FBrow) * fb_width) + fb_hbord + FBcol];
+    const uint32_t* pal = PalARGB[(VidCtl & VCTL_GREY) != 0];
+    if (VidCtl & VCTL_16COL) {
+        // pixel bit 1 selects the upper 16 colours, bit 0 the attribute FG or BG
+        uint8_t fg = bg_attr&15, bg = bg_attr>>4;
+        const uint32_t col[4] = { pal[bg], pal[fg], pal[16|bg], pal[16|fg] };
+        for (int sub=0; sub<8; sub++) out[sub] = col[pixel[sub]&3];
+    } else {
+        uint8_t attr = (bg_attr&14)<<1;
+        for (int sub=0; sub<8; sub++) out[sub] = pal[attr | pixel[sub]];
+    }
+    FBcol += 8;
+}
+
+// end of a tile: horizontal and vertical counters and timing events
+// (returns 1 if HDMA ran, which moves the CPU clock on and may write IO_VCTL)
+static int vdp_tile_end() {
+    int hdma = 0;
+    // update horizontal address and timing counter
+    uint16_t Hmask = (1 << (5+(NameSize>>2))) - 1; // 5-8 bits (32,64,128,256)
+    vdp_htile = (vdp_htile+1) & Hmask;
+    vdp_hcount++;
+    if (vdp_hcount == 38) { // finish reading BG early (started early)
+        // MUST end TWO tiles early (becase we started TWO tiles early)
+        vdp_hbusy = 0;      // stop loading BG graphics
+    }
+    if (vdp_hcount == 40) {
+        vdp_hborder = 1;     // turn on border (overscan)
+    }
+    if (vdp_hcount == 40+9) {
+        vdp_hblank = 1;      // turn on HBLANK
+        if (VidEna & VENA_HDMA_En) {
+            // HDMA steals CPU cycles: the CPU clock moves on, so does the target
+            hdma_line(vdp_vcount, vdp_cpu_clk(vdp_clk));
+            hdma = 1;
+        }
+    }
+    // HSYNC happens in 13 tiles of HBLANK
+    if (vdp_hcount == 40+9+13) {
+        vdp_hblank = 0;      // turn off HBLANK
+    }
+    if (vdp_hcount == 40+9+13+9 - 2) { // early line start
+        // MUST start TWO tiles early (see above)
+        vdp_hbusy = 1; // start loading BG graphics
+        vdp_vram_lock = 1; // locked while hbusy
+        // update vertical sub-tile counter
+        if (vdp_vsub == 7) {
+            // next tile-row vertically
+            vdp_vsub = 0;
+            // during visible area, increment vtile at the end of each line
+            if (vdp_vborder == 0) {
+                uint16_t Vmask = (1 << (5+(NameSize&3))) - 1; // 5-8 bits (32,64,128,256)
+                vdp_vtile = (vdp_vtile+1) & Vmask;
+            } else if (vdp_vcount == 311) {
+                // on the last line before visible lines start,
+                // at the point of early line start, reset vsub and vtile.
+                vdp_vbusy = 1;
+                // uint16_t Vmask = (1 << (5+(NameSize&3))) - 1; // 5-8 bits (32,64,128,256)
+                vdp_vtile = 0; // VidScrV & Vmask; // reload vertical tile counter
+                vdp_vsub = 0; // VidFinV & 3;  // reload vertical sub-tile counter
+            }
+        } else {
+            vdp_vsub++;
+        }
+        // reload horizontal tile counter
+        uint16_t Hmask = (1 << (5+(NameSize>>2))) - 1; // 5-8 bits (32,64,128,256)
+        vdp_htile = VidScrH & Hmask; // reload horizontal tile counter
+        FBcol = 0; // reset framebuffer column
+        bg_shift = 0xFFFF; // XXX debugging
+        bg_attr = bg_ld_gfx0 = bg_ld_gfx1 = 0xFF; // XXX leaking in on the left side
+    }
+    if (vdp_hcount == 40+9+13+9) { // 71*8=568
+        // end of the scanline
+        vdp_hcount = 0;      // reset hcount
+        vdp_hborder = 0;     // turn off border (overscan)
+        if (vdp_vborder == 0 && FBrow < fb_height-1) { // necessary?
+            FBrow++;
+            int coord = (((fb_vbord+FBrow) * fb_width) + fb_hbord);
+            FBspan = &FB[coord];      // next framebuffer row
+            // printf("+++ row %d\n", FBrow);
+        }
+        // update line counter
+        vdp_vcount++;
+        if (vdp_vcount == 224) { // 28 lines * 8 = 224
+            vdp_vborder = 1;
+            vdp_vbusy = 0;
+            if (VidEna & VENA_VSync) {
+                VidSta |= VSTA_VSync;
+                request_irq();
+            }
+        }
+        if (vdp_vcount == 224+32) {
+            vdp_vblank = 1;
+            vdp_frames++;
+            // printf("+++ flip %d\n", FBrow);
+            if (vdp_present) render();
+            if (vdp_count) stats_frame();
+        }
+        // VSYNC happens in the 24 tiles of VBLANK
+        if (vdp_vcount == 224+32+24) {
+            vdp_vblank = 0;
+        }
+        if (vdp_vcount == 224+32+24+32) { // 312
+            // start of next frame
+            vdp_hsub = 0;
+            vdp_vcount = 0;      // reset vcount
+            vdp_vborder = 0;     // start display output
+            int topleft = ((fb_vbord * fb_width) + fb_hbord);
+            FBspan = &FB[topleft];     // reset FB
+            FBcol = 0;
+            FBrow = 0;
+        }
+    }
+    return hdma;
 }
 
 // advance the renderer to catch up with the CPU clock (clockticks6502)
 // the current vdp_clk has already been processed
+// Whole tiles go through vdp_tile(); only a tile cut by a sync point (an IO access
+// that affects or observes the VDP) is run clock by clock, on either side of it.
 void advance_vdp() {
     // NTSC: 14.31818 Mhz: CPU is 1/7 at 2.045454; VDP shift clk is 1/2 at 7.15909 MHz (139.68ns)
     // PAL 17.734475 MHz: CPU is 1/9 at 1.970497; VDP shift clk is 1/2 at 8.8672375 MHz (112.77ns)
-    uint64_t vdp_target = (clockticks6502 * 9) / 2;
-    // VCTL (1-0) Divider (DD) is 0=512 (2bpp) 1=320 (2bpp) 2=160 (4bpp)
-    uint16_t bpp = (VidCtl & VCTL_4BPP); // 0=2bpp 1=4bpp
-    uint32_t bpp_shift = 24 - (2 << bpp); // shift down from bit 24 (22 or 20)
-    // uint32_t bpp_mask = (1 << (2 << bpp))-1; // (3 or 15)
+    uint64_t vdp_target = ((uint64_t)clockticks6502 * 9) / 2;
+    BusStats.vdp_syncs++;
+    uint16_t bpp = 0;
+    uint32_t bpp_shift = 0;
+    uint8_t bpp_mask = 0;
+    int vctl = 1; // read VidCtl: at the start, and again after an HDMA line
     while (vdp_clk < vdp_target) {
+        if (vctl) {
+            // VCTL (1-0) Divider (DD) is 0=512 (2bpp) 1=320 (2bpp) 2=160 (4bpp)
+            bpp = (VidCtl & VCTL_4BPP); // 0=2bpp 1=4bpp
+            bpp_shift = 24 - (2 << bpp); // shift down from bit 24 (22 or 20)
+            bpp_mask = (1 << (2 << bpp))-1; // (3 or 15)
+            vctl = 0;
+        }
+        if (vdp_hsub == 0 && vdp_target - vdp_clk >= 8) {
+            vdp_tile(bpp, bpp_shift, bpp_mask);
+            vdp_clk += 8;
+            if (vdp_tile_end()) {
+                vdp_target = ((uint64_t)clockticks6502 * 9) / 2;
+                vctl = 1;
+            }
+            continue;
+        }
         // start early, two tiles from the end of the previous line:
         // tile 0: load 1st BG tile graphics.
         // tile 1: shift 1st BG tile into pixel shift register; load 2nd BG tile graphics.
@@ -201,120 +524,19 @@ void advance_vdp() {
             // latch the pixel every Nth clk (N=bpp) [falling edge]
             if ((vdp_hsub & bpp) == 0) { // h&0 (always) or H&1 (every 2nd)
                 //bg_pixel = bg_shift & (bpp_mask << (VidFinH << 1));
-                bg_pixel = (bg_shift >> bpp_shift); // take `bpp` top bits of 24-bit
+                bg_pixel = (bg_shift >> bpp_shift) & bpp_mask; // take `bpp` top bits of 24-bit
             }
             // pixel output
-            uint8_t text_col;
-            if (VidCtl & VCTL_16COL) {
-                text_col = ((bg_pixel&2)<<3) | ((bg_pixel&1) ? (bg_attr&15) : (bg_attr>>4)); // 16-color mode.
-            } else {
-                text_col = ((bg_attr&14)<<1) | bg_pixel; // 4-color mode (8-palettes)
-            }
-            uint8_t px = PAL_RAM[text_col]; // [IIRRGGBB]
-            if (FBrow < fb_height && FBcol < fb_width) { // safety check
-                static uint8_t chroma[4] = {0x00,0x60,0xB0,0xF0}; // 0.....6....B...F
-                static uint8_t luma[4] = {0x05,0x09,0x0C,0x0F};   // .....5...9..C..F
-                uint32_t red = chroma[(px>>4)&3] | luma[px>>6]; // red
-                uint32_t green = chroma[(px>>2)&3] | luma[px>>6]; // green
-                uint32_t blue = chroma[(px>>0)&3] | luma[px>>6]; // blue
-                uint32_t output = 0xFF000000 | (red<<16) | (green<<8) | blue;
-                int coord = ((fb_vbord+FBrow) * fb_width) + fb_hbord + FBcol;
-                FB[coord] = output;
-                FBcol++;
-            }
+            vdp_pixel();
         }
         vdp_clk++;
         // PAL timing: 320+72+104+72 = 568
         vdp_hsub++;
         if (vdp_hsub == 8) {
             vdp_hsub = 0;
-            // update horizontal address and timing counter
-            uint16_t Hmask = (1 << (5+(NameSize>>2))) - 1; // 5-8 bits (32,64,128,256)
-            vdp_htile = (vdp_htile+1) & Hmask;
-            vdp_hcount++;
-            if (vdp_hcount == 38) { // finish reading BG early (started early)
-                // MUST end TWO tiles early (becase we started TWO tiles early)
-                vdp_hbusy = 0;      // stop loading BG graphics
-            }
-            if (vdp_hcount == 40) {
-                vdp_hborder = 1;     // turn on border (overscan)
-            }
-            if (vdp_hcount == 40+9) {
-                vdp_hblank = 1;      // turn on HBLANK
-            }
-            // HSYNC happens in 13 tiles of HBLANK
-            if (vdp_hcount == 40+9+13) {
-                vdp_hblank = 0;      // turn off HBLANK
-            }
-            if (vdp_hcount == 40+9+13+9 - 2) { // early line start
-                // MUST start TWO tiles early (see above)
-                vdp_hbusy = 1; // start loading BG graphics
-                vdp_vram_lock = 1; // locked while hbusy
-                // update vertical sub-tile counter
-                if (vdp_vsub == 7) {
-                    // next tile-row vertically
-                    vdp_vsub = 0;
-                    // during visible area, increment vtile at the end of each line
-                    if (vdp_vborder == 0) {
-                        uint16_t Vmask = (1 << (5+(NameSize&3))) - 1; // 5-8 bits (32,64,128,256)
-                        vdp_vtile = (vdp_vtile+1) & Vmask;
-                    } else if (vdp_vcount == 311) {
-                        // on the last line before visible lines start,
-                        // at the point of early line start, reset vsub and vtile.
-                        vdp_vbusy = 1;
-                        // uint16_t Vmask = (1 << (5+(NameSize&3))) - 1; // 5-8 bits (32,64,128,256)
-                        vdp_vtile = 0; // VidScrV & Vmask; // reload vertical tile counter
-                        vdp_vsub = 0; // VidFinV & 3;  // reload vertical sub-tile counter
-                    }
-                } else {
-                    vdp_vsub++;
-                }
-                // reload horizontal tile counter
-                uint16_t Hmask = (1 << (5+(NameSize>>2))) - 1; // 5-8 bits (32,64,128,256)
-                vdp_htile = VidScrH & Hmask; // reload horizontal tile counter
-                FBcol = 0; // reset framebuffer column
-                bg_shift = 0xFFFF; // XXX debugging
-                bg_attr = bg_ld_gfx0 = bg_ld_gfx1 = 0xFF; // XXX leaking in on the left side
-            }
-            if (vdp_hcount == 40+9+13+9) { // 71*8=568
-                // end of the scanline
-                vdp_hcount = 0;      // reset hcount
-                vdp_hborder = 0;     // turn off border (overscan)
-                if (vdp_vborder == 0 && FBrow < fb_height-1) { // necessary?
-                    FBrow++;
-                    int coord = (((fb_vbord+FBrow) * fb_width) + fb_hbord);
-                    FBspan = &FB[coord];      // next framebuffer row
-                    // printf("+++ row %d\n", FBrow);
-                }
-                // update line counter
-                vdp_vcount++;
-                if (vdp_vcount == 224) { // 28 lines * 8 = 224
-                    vdp_vborder = 1;
-                    vdp_vbusy = 0;
-                    if (VidEna & VENA_VSync) {
-                        VidSta |= VSTA_VSync;
-                        request_irq();
-                    }
-                }
-                if (vdp_vcount == 224+32) {
-                    vdp_vblank = 1;
-                    // printf("+++ flip %d\n", FBrow);
-                    render();
-                }
-                // VSYNC happens in the 24 tiles of VBLANK
-                if (vdp_vcount == 224+32+24) {
-                    vdp_vblank = 0;
-                }
-                if (vdp_vcount == 224+32+24+32) { // 312
-                    // start of next frame
-                    vdp_hsub = 0;
-                    vdp_vcount = 0;      // reset vcount
-                    vdp_vborder = 0;     // start display output
-                    int topleft = ((fb_vbord * fb_width) + fb_hbord);
-                    FBspan = &FB[topleft];     // reset FB
-                    FBcol = 0;
-                    FBrow = 0;
-                }
+            if (vdp_tile_end()) {
+                vdp_target = ((uint64_t)clockticks6502 * 9) / 2;
+                vctl = 1;
             }
         }
     }
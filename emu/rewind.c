@@ -0,0 +1,236 @@
+// Robo Emulator - Rewind
+
+// A ring of per-frame records in a fixed arena (the memory budget). Each record
+// holds its frame's registers (STATE_REGS) and XOR+RLE deltas from the previous
+// frame for the pages written in between (PageDirty: RAM, banks, VRAM, palette,
+// sprites). The shadow holds memory as of the last capture. XOR works both ways,
+// so going back one frame applies the newest record's deltas to memory and the
+// shadow. Every REWIND_KEY frames a record holds a full state without the
+// framebuffer (keyframe), which resyncs anything the page tracking cannot see.
+// Capture cost is bounded by the pages written in a frame.
+// The framebuffer is not kept: the caller runs one frame after each step to show it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "header.h"
+
+enum rewind_const {
+    REWIND_MAX     = 4096,              // records (over 80 seconds at 50 Hz)
+    REWIND_KEY     = 250,               // keyframe interval (5 seconds)
+    REWIND_END     = 0xFFFF,            // end of the page deltas
+    REWIND_PAGE    = 2+2*256+2,         // worst case encoded page: id, ops, end
+    REWIND_REGS    = 1024,              // room for state_save_regs
+};
+
+typedef struct rewind_rec {
+    uint32_t size;            // bytes including this header (multiple of 4)
+    uint32_t clock;           // clockticks6502 at capture
+    uint32_t state;           // bytes of state that follow
+    uint8_t skip;             // enum state_skip: STATE_REGS, or STATE_NO_FB for keyframes
+    uint8_t pad[3];
+} rewind_rec;                 // followed by state, then [u16 page, ops..., 0, 0]..., u16 REWIND_END
+
+static uint8_t* RwArena = 0;
+static size_t RwCap = 0;
+static uint8_t* RwShadow = 0;         // memory at the last capture (256 bytes per page)
+static uint8_t* RwScratch = 0;        // record being built
+static size_t RwScratchCap = 0;
+static uint32_t RwOff[REWIND_MAX];    // record offsets in the arena (ring)
+static uint32_t RwFirst = 0;          // oldest record
+static uint32_t RwCount = 0;
+static uint32_t RwSince = 0;          // frames since the last keyframe
+
+// host memory for page `page`, or 0 if not writable
+static uint8_t* rw_page(unsigned page, size_t* len) {
+    *len = (page == PAGE_PAL) ? PAL_SIZE : (page == PAGE_SPR) ? SPR_SIZE : 256;
+    return ula_page(page);
+}
+
+static rewind_rec* rw_rec(uint32_t n) {
+    return (rewind_rec*)(RwArena + RwOff[(RwFirst + n) % REWIND_MAX]);
+}
+
+// copy all memory to the shadow (unwritable pages read as zero)
+static void rw_sync() {
+    for (unsigned page=0; page<PAGE_COUNT; page++) {
+        size_t len;
+        uint8_t* mem = rw_page(page, &len);
+        if (mem) memcpy(RwShadow + (page << 8), mem, len);
+        else memset(RwShadow + (page << 8), 0, 256);
+    }
+    memset(PageDirty, 0, sizeof(PageDirty));
+}
+
+int rewind_init(size_t budget) {
+    RwCap = budget & ~(size_t)3;
+    RwArena = malloc(RwCap);
+    RwShadow = calloc(PAGE_COUNT, 256);
+    if (!RwArena || !RwShadow) {
+        free(RwArena);
+        free(RwShadow);
+        RwArena = RwShadow = 0;
+        return 0;
+    }
+    rewind_reset();
+    return 1;
+}
+
+void rewind_reset() {
+    if (!RwArena) return;
+    RwCount = 0;
+    RwSince = 0;
+    rw_sync();
+}
+
+uint32_t rewind_frames() {
+    return RwCount;
+}
+
+// XOR+RLE: ops of [skip, count, count bytes of mem^shadow], then [0, 0].
+// Updates the shadow; returns 0 if the page is unchanged.
+static size_t rw_encode(uint8_t* out, uint8_t* mem, uint8_t* shadow, size_t len) {
+    size_t i = 0, o = 0, skip = 0;
+    while (i < len) {
+        if (mem[i] == shadow[i]) {
+            i++;
+            skip++;
+            continue;
+        }
+        for (; skip > 255; skip -= 255) {
+            out[o++] = 255;   // [255, 0]: skip only
+            out[o++] = 0;
+        }
+        out[o] = skip;
+        size_t at = o + 1, lit = 0;
+        o += 2;
+        skip = 0;
+        while (i < len && mem[i] != shadow[i] && lit < 255) {
+            out[o++] = mem[i] ^ shadow[i];
+            shadow[i] = mem[i];
+            i++; lit++;
+        }
+        out[at] = lit;
+    }
+    if (!o) return 0;
+    out[o++] = 0;
+    out[o++] = 0;
+    return o;
+}
+
+static size_t rw_delta(size_t pos, unsigned page) {
+    size_t len;
+    uint8_t* mem = rw_page(page, &len);
+    if (!mem) return pos;
+    size_t n = rw_encode(RwScratch + pos + 2, mem, RwShadow + (page << 8), len);
+    if (!n) return pos;
+    uint16_t id = page;
+    memcpy(RwScratch + pos, &id, 2);
+    return pos + 2 + n;
+}
+
+// append the scratch record, evicting the oldest records to make room.
+static void rw_store(size_t size) {
+    if (size > RwCap) {
+        RwCount = 0;          // cannot hold even one frame: history restarts
+        return;
+    }
+    size_t pos = 0;
+    if (RwCount) {
+        rewind_rec* newest = rw_rec(RwCount-1);
+        pos = (uint8_t*)newest - RwArena + newest->size;
+    }
+    if (pos + size > RwCap) {
+        // wrap: drop the records between here and the end of the arena
+        while (RwCount && RwOff[RwFirst] >= pos) { RwFirst = (RwFirst+1) % REWIND_MAX; RwCount--; }
+        pos = 0;
+    }
+    while (RwCount && (RwCount == REWIND_MAX || (RwOff[RwFirst] >= pos && RwOff[RwFirst] < pos + size))) {
+        RwFirst = (RwFirst+1) % REWIND_MAX;
+        RwCount--;
+    }
+    memcpy(RwArena + pos, RwScratch, size);
+    RwOff[(RwFirst + RwCount) % REWIND_MAX] = pos;
+    RwCount++;
+}
+
+void rewind_capture() {
+    if (!RwArena) return;
+    uint8_t skip = RwSince ? STATE_REGS : STATE_NO_FB;
+    RwSince = (RwSince + 1) % REWIND_KEY;
+    size_t need = sizeof(rewind_rec) + state_size_part(skip) + PAGE_COUNT * REWIND_PAGE + 2 + 3;
+    if (need > RwScratchCap) {
+        uint8_t* buf = realloc(RwScratch, need);
+        if (!buf) return;
+        RwScratch = buf;
+        RwScratchCap = need;
+    }
+    size_t pos = sizeof(rewind_rec);
+    size_t state = state_save_part(RwScratch + pos, RwScratchCap - pos, skip);
+    pos += state;
+    for (unsigned page=0; page<PAGE_COUNT; page++) {
+        if (!PageDirty[page]) continue;
+        PageDirty[page] = 0;
+        pos = rw_delta(pos, page);
+    }
+    uint16_t end = REWIND_END;
+    memcpy(RwScratch + pos, &end, 2);
+    pos = (pos + 2 + 3) & ~(size_t)3;
+    rewind_rec rec = { (uint32_t)pos, clockticks6502, (uint32_t)state, skip, {0} };
+    memcpy(RwScratch, &rec, sizeof(rec));
+    rw_store(pos);
+    if (skip != STATE_REGS) rw_sync();        // keyframe: resync the shadow
+}
+
+// XOR a record's deltas into memory and the shadow: memory goes back one frame.
+static void rw_apply(rewind_rec* rec) {
+    uint8_t* at = (uint8_t*)rec + sizeof(rewind_rec) + rec->state;
+    for (;;) {
+        uint16_t page;
+        memcpy(&page, at, 2);
+        at += 2;
+        if (page == REWIND_END) break;
+        size_t len;
+        uint8_t* mem = rw_page(page, &len);
+        uint8_t* shadow = RwShadow + (page << 8);
+        size_t i = 0;
+        while (at[0] || at[1]) {
+            i += at[0];
+            for (unsigned n=0; n<at[1]; n++, i++) {
+                if (mem) mem[i] ^= at[2+n];
+                shadow[i] ^= at[2+n];
+            }
+            at += 2 + at[1];
+        }
+        at += 2;
+    }
+}
+
+static int rw_load(rewind_rec* rec) {
+    int ok = state_load_part((uint8_t*)rec + sizeof(rewind_rec), rec->state, rec->skip);
+    if (rec->skip != STATE_REGS) rw_sync();   // keyframe: memory is whole again
+    return ok;
+}
+
+// Back to the newest capture, then one record further if already there.
+int rewind_step() {
+    if (!RwCount) return 0;
+    rewind_rec* newest = rw_rec(RwCount-1);
+    if (clockticks6502 != newest->clock) {
+        // undo the pages written since the capture
+        for (unsigned page=0; page<PAGE_COUNT; page++) {
+            if (!PageDirty[page]) continue;
+            size_t len;
+            uint8_t* mem = rw_page(page, &len);
+            if (mem) memcpy(mem, RwShadow + (page << 8), len);
+        }
+        memset(PageDirty, 0, sizeof(PageDirty));
+    }
+    if (RwCount == 1) {
+        rw_load(newest);      // the oldest frame: stay there
+        return 0;
+    }
+    rw_apply(newest);
+    RwCount--;
+    return rw_load(rw_rec(RwCount-1));
+}
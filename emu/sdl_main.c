@@ -14,20 +14,191 @@ const uint32_t one_scanline = 568*2/9; // PAL 568 pixels at 1/2 of 17.734475, CP
 const Uint8 *keys = 0;
 static Uint8 dbg_mode = 1;
 
+// Run until the VDP completes a frame.
+static void run_frame() {
+    uint32_t frame = vdp_frames;
+    while (vdp_frames == frame) {
+        exec6502(one_scanline);
+        advance_vdp();
+    }
+}
+
+// Run-ahead: present the frame `frames` frames from now (with the current
+// input), then roll back. The framebuffer is not saved: an ahead frame redraws it.
+// Ahead frames leave no trace outside the state: BusStats and KbdReads (the boot
+// cache waits for it) are put back, nothing goes to the IO log, and disk writes
+// are skipped (the real frame makes them).
+static void run_ahead(int frames) {
+    static uint8_t* buf = 0;
+    static size_t cap = 0;
+    size_t need = state_size_part(STATE_NO_FB);
+    if (need > cap) {
+        free(buf);
+        buf = malloc(need);
+        cap = buf ? need : 0;
+        if (!buf) return;
+    }
+    size_t len = state_save_part(buf, cap, STATE_NO_FB);
+    bus_stats stats = BusStats;
+    uint32_t kbd_reads = KbdReads;
+    uint64_t iolog = IoLogMask;
+    IoLogMask = 0;
+    DiskNoWrite = 1;
+    vdp_count = 0;
+    for (int i=0; i<frames; i++) {
+        vdp_present = (i == frames-1);
+        run_frame();
+    }
+    vdp_present = 0;
+    vdp_count = 1;
+    DiskNoWrite = 0;
+    IoLogMask = iolog;
+    BusStats = stats;
+    KbdReads = kbd_reads;
+    state_load_part(buf, len, STATE_NO_FB);
+}
+
+// Map a cartridge image at `bank`, spanning as many 16K banks as the file needs.
+// ROM is mapped read-only; battery RAM is read/write (at least one bank).
+static int map_cart(unsigned bank, const char* filename, int ram) {
+    size_t banks = (binary_file_size(filename) + 0x3FFF) >> 14;
+    if (ram && !banks) banks = 1;
+    if (bank >= 64 || !banks || bank + banks > 64) {
+        printf("cannot map %s at bank %u\n", filename, bank);
+        return 0;
+    }
+    uint8_t* mem = map_binary_file(filename, banks << 14, ram);
+    if (!mem) return 0;
+    for (size_t i=0; i<banks; i++) {
+        ula_map_bank(bank+i, mem + (i << 14), ram);
+    }
+    printf("mapped %s at bank %u (%zuK %s)\n", filename, bank, banks*16, ram ? "RAM" : "ROM");
+    return 1;
+}
+
+// Keys that scanKeyCol maps into the matrix, not F-keys or host hotkeys (modifiers
+// alone are left out too: the ROM echoes nothing for them).
+static int matrix_key(SDL_Scancode sc) {
+    switch (sc) {
+        case SDL_SCANCODE_1: case SDL_SCANCODE_2: case SDL_SCANCODE_3: case SDL_SCANCODE_4:
+        case SDL_SCANCODE_5: case SDL_SCANCODE_6: case SDL_SCANCODE_7: case SDL_SCANCODE_8:
+        case SDL_SCANCODE_9: case SDL_SCANCODE_0: case SDL_SCANCODE_MINUS: case SDL_SCANCODE_EQUALS:
+        case SDL_SCANCODE_GRAVE: case SDL_SCANCODE_BACKSPACE: case SDL_SCANCODE_TAB:
+        case SDL_SCANCODE_Q: case SDL_SCANCODE_W: case SDL_SCANCODE_E: case SDL_SCANCODE_R:
+        case SDL_SCANCODE_T: case SDL_SCANCODE_Y: case SDL_SCANCODE_U: case SDL_SCANCODE_I:
+        case SDL_SCANCODE_O: case SDL_SCANCODE_P: case SDL_SCANCODE_LEFTBRACKET:
+        case SDL_SCANCODE_RIGHTBRACKET: case SDL_SCANCODE_BACKSLASH: case SDL_SCANCODE_CAPSLOCK:
+        case SDL_SCANCODE_A: case SDL_SCANCODE_S: case SDL_SCANCODE_D: case SDL_SCANCODE_F:
+        case SDL_SCANCODE_G: case SDL_SCANCODE_H: case SDL_SCANCODE_J: case SDL_SCANCODE_K:
+        case SDL_SCANCODE_L: case SDL_SCANCODE_SEMICOLON: case SDL_SCANCODE_APOSTROPHE:
+        case SDL_SCANCODE_RETURN: case SDL_SCANCODE_Z: case SDL_SCANCODE_X: case SDL_SCANCODE_C:
+        case SDL_SCANCODE_V: case SDL_SCANCODE_B: case SDL_SCANCODE_N: case SDL_SCANCODE_M:
+        case SDL_SCANCODE_COMMA: case SDL_SCANCODE_PERIOD: case SDL_SCANCODE_SLASH:
+        case SDL_SCANCODE_SPACE: case SDL_SCANCODE_UP: case SDL_SCANCODE_DOWN:
+        case SDL_SCANCODE_LEFT: case SDL_SCANCODE_RIGHT: case SDL_SCANCODE_ESCAPE:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
 int main(int argc, char *argv[]) {
-    (void)argc; (void)argv;
+    // command line:
+    //   -stats FILE      per-frame bus stats (.csv or .json)
+    //   -cart BANK FILE  map a ROM cartridge image at BANK (0-63)
+    //   -bram BANK FILE  map a battery-backed RAM image at BANK (0-63)
+    //   -ram FIRST-LAST  expansion RAM in banks FIRST..LAST (16-63, allocated on first write)
+    //   -break [BB:]XXXX debugger breakpoint, optionally in bank BB (hex)
+    //   -noaccel         without the Booth multiplier and DMA fastload
+    //   -iolog PORTS FILE  log IO events for PORTS ("all" or e.g. "D0-D8,F2"), dumped to FILE
+    //   -state FILE      save state file for F5 (save) and F9 (load); loaded at start if present
+    //   -rewind MB       rewind history budget (default 32, 0 = off); hold F8 to rewind
+    //   -boot FILE       boot snapshot cache (default robo.boot), used when the ROM and options match
+    //   -coldboot        always boot the ROM (neither use nor update the boot cache)
+    //   -record FILE     record keyboard input from the start state, written at exit
+    //   -replay FILE     replay a recording, then print the time taken and a state hash and exit
+    //   -headless        no window (for replays)
+    //   -runahead N      present the frame N frames ahead (1-4) to cut input latency
+    //   -latency         measure key press to screen latency, reported on F10 and at exit
+    //   -disk PATH       disk interface on a disk image file or a host directory
+    //   -diskrom FILE    disk interface ROM (mapped at the first expansion bank)
+    int break_set = 0;
+    const char* iolog_file = 0;
+    const char* state_file = "robo.state";
+    int state_start = 0;
+    size_t rewind_mb = 32;
+    const char* boot_file = "robo.boot";
+    int boot_cache = 1;
+    const char* record_file = 0;
+    const char* replay_file = 0;
+    int headless = 0;
+    int ahead_frames = 0;
+    for (int i=1; i<argc; i++) {
+        if (!strcmp(argv[i], "-stats") && i+1 < argc) {
+            if (!stats_open(argv[++i])) printf("cannot open stats file %s\n", argv[i]);
+        } else if ((!strcmp(argv[i], "-cart") || !strcmp(argv[i], "-bram")) && i+2 < argc) {
+            map_cart((unsigned)atoi(argv[i+1]), argv[i+2], argv[i][1] == 'b');
+            i += 2;
+        } else if (!strcmp(argv[i], "-ram") && i+1 < argc) {
+            unsigned first = 0, last = 0;
+            int n = sscanf(argv[++i], "%u-%u", &first, &last);
+            if (n == 1) last = first;
+            if (n < 1 || first < 16 || last > 63 || first > last) {
+                printf("cannot map RAM at banks %s (expansion memory is 16-63)\n", argv[i]);
+            } else {
+                for (unsigned b=first; b<=last; b++) ula_map_ram(b);
+            }
+        } else if (!strcmp(argv[i], "-iolog") && i+2 < argc) {
+            IoLogMask = iolog_ports(argv[i+1]);
+            iolog_file = argv[i+2];
+            i += 2;
+        } else if (!strcmp(argv[i], "-state") && i+1 < argc) {
+            state_file = argv[++i];
+            state_start = 1;
+        } else if (!strcmp(argv[i], "-rewind") && i+1 < argc) {
+            int mb = atoi(argv[++i]);
+            rewind_mb = mb > 0 ? (size_t)mb : 0;
+        } else if (!strcmp(argv[i], "-boot") && i+1 < argc) {
+            boot_file = argv[++i];
+        } else if (!strcmp(argv[i], "-coldboot")) {
+            boot_cache = 0;
+        } else if (!strcmp(argv[i], "-record") && i+1 < argc) {
+            record_file = argv[++i];
+        } else if (!strcmp(argv[i], "-replay") && i+1 < argc) {
+            replay_file = argv[++i];
+        } else if (!strcmp(argv[i], "-headless")) {
+            headless = 1;
+        } else if (!strcmp(argv[i], "-runahead") && i+1 < argc) {
+            ahead_frames = atoi(argv[++i]);
+            if (ahead_frames < 0) ahead_frames = 0;
+            if (ahead_frames > 4) ahead_frames = 4;
+        } else if (!strcmp(argv[i], "-latency")) {
+            if (!lat_open()) printf("cannot allocate latency samples\n");
+        } else if (!strcmp(argv[i], "-disk") && i+1 < argc) {
+            disk_open(argv[++i]);
+        } else if (!strcmp(argv[i], "-diskrom") && i+1 < argc) {
+            map_cart(DISK_ROM_BANK, argv[++i], 0);
+        } else if (!strcmp(argv[i], "-noaccel")) {
+            HwAccel = 0;
+        } else if (!strcmp(argv[i], "-break") && i+1 < argc) {
+            if (dbg_parse_break(argv[++i])) break_set = 1;
+            else printf("bad breakpoint %s\n", argv[i]);
+        }
+    }
 
      char cwd[PATH_MAX];
     if (!getcwd(cwd, sizeof(cwd))) { cwd[0] = 'X'; cwd[1] = 0; }
     printf("dir %s\n", cwd);
 
-    // load the ROM image.
-    memset(SysROM, 0xFF, sizeof(SysROM));
-    size_t rom_size = read_binary_file("rom.bin", (char*)SysROM, sizeof(SysROM));
-    printf("loaded ROM %zu\n", rom_size);
+    // map the ROM image (banks 0-3), or load it if it cannot be mapped.
+    if (!map_cart(0, "rom.bin", 0)) {
+        memset(SysROM, 0xFF, sizeof(SysROM));
+        size_t rom_size = read_binary_file("rom.bin", (char*)SysROM, sizeof(SysROM));
+        printf("loaded ROM %zu\n", rom_size);
+    }
 
     // create window.
-    if (!init_render()) {
+    if (!headless && !init_render()) {
         printf("cannot create SDL window\n");
         return 1;
     }
@@ -35,32 +206,102 @@ int main(int argc, char *argv[]) {
     // get the keys array - valid for app lifetime.
     // value of 1 means the key is pressed, value of 0 means that it is not.
     keys = SDL_GetKeyboardState(NULL);
+    vdp_palette_all();        // resolve the power-on palette (also when headless)
 
-    // start the CPU.
+    // start the CPU, or restore the boot snapshot taken with the same ROM and options.
+    uint64_t boot_key = ula_config_hash();
+    int boot_pending = 0;
     reset6502();
+    if (state_start && state_load_file(state_file)) {
+        printf("loaded state %s\n", state_file);
+    } else if (boot_cache) {
+        if (state_load_boot(boot_file, boot_key)) printf("restored boot snapshot %s\n", boot_file);
+        else boot_pending = 1;    // save it once the ROM has booted
+    }
+    if (replay_file) {
+        if (!input_replay(replay_file)) {
+            printf("cannot replay %s\n", replay_file);
+            return 1;
+        }
+        boot_pending = 0;
+    } else if (record_file && !input_record(record_file)) {
+        printf("cannot record to %s\n", record_file);
+    }
+    Uint32 replay_time = SDL_GetTicks();
+    uint32_t replay_frame = BusStats.frame;
+    if (rewind_mb && !rewind_init(rewind_mb << 20)) {
+        printf("cannot allocate %zuMB for rewind\n", rewind_mb);
+    }
+    uint32_t rewind_frame = BusStats.frame;
+    uint32_t ahead_frame = BusStats.frame;
 
     // DEBUGGER
-    dbg_enable = 0;
-    dbg_break = 0x0C41C;
+    dbg_enable = break_set;
+    if (!break_set) dbg_break = 0x0C41C;
     Uint32 held_time = 0;
 
     // run the simulator.
     SDL_Event event;
     int running = 1;
+    Uint32 sync_time = SDL_GetTicks() + 1000;
     while (running) {
+        // flush battery RAM once a second.
+        if (SDL_GetTicks() >= sync_time) {
+            sync_binary_files(0);
+            sync_time = SDL_GetTicks() + 1000;
+        }
+
         // process events.
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
                 running = 0;
             }
+            if (event.type == SDL_KEYDOWN && !event.key.repeat && LatState && matrix_key(event.key.keysym.scancode)) {
+                lat_key(event.key.timestamp);
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F10) {
+                lat_report();
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F12) {
+                stats_report(); // bus stats on request
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F11 && iolog_file) {
+                iolog_dump(iolog_file); // IO log on request
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F5) {
+                if (state_save_file(state_file)) printf("saved state %s\n", state_file);
+                else printf("cannot save state %s\n", state_file);
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F9 && input_mode() == INPUT_LIVE) {
+                if (state_load_file(state_file)) printf("loaded state %s\n", state_file);
+                else printf("cannot load state %s\n", state_file);
+                rewind_reset();
+            }
         }    
 
+        // with run-ahead, only the ahead frames are presented.
+        int ahead = ahead_frames && !dbg_enable && input_mode() == INPUT_LIVE;
+        vdp_present = !ahead;
+
+        // rewind one frame per display refresh while F8 is held:
+        // step back to the previous capture, then run one frame to show it.
+        if (keys[SDL_SCANCODE_F8] && input_mode() == INPUT_LIVE) {
+            if (rewind_step()) {
+                vdp_present = 1;
+                run_frame();
+                rewind_frame = BusStats.frame;   // not captured
+            } else {
+                render();
+            }
+            continue;
+        }
+
         // run the CPU.
         if (!dbg_enable) {
             exec6502(one_scanline);
         } else {
             // debugger
-            if (pc != dbg_break) {
+            if (!dbg_at_break(pc)) {
                 // run until we hit the breakpoint.
                 exec6502(one_scanline);
             } else {
@@ -73,6 +314,7 @@ int main(int argc, char *argv[]) {
                         step6502();
                         dbg_decode_next_op(old_pc);
                         dbg_break = pc; // advance the breakpoint
+                        dbg_break_bank = ula_bank_at(pc);
                     } else if (SDL_GetTicks() > held_time) {
                         // auto-repeat
                         held_time = SDL_GetTicks() + 80;
@@ -80,9 +322,11 @@ int main(int argc, char *argv[]) {
                         step6502();
                         dbg_decode_next_op(old_pc);
                         dbg_break = pc; // advance the breakpoint
+                        dbg_break_bank = ula_bank_at(pc);
                     }
                 } else if (keys[SDL_SCANCODE_RALT]) {
                     dbg_break = 0; // continue
+                    dbg_break_bank = 0xFF;
                 } else {
                     dbg_mode = 1; // back to waiting
                 }
@@ -91,11 +335,44 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        // boot snapshot: the ROM starts scanning the keyboard once it has booted.
+        if (boot_pending && KbdReads) {
+            boot_pending = 0;
+            if (state_save_boot(boot_file, boot_key)) printf("saved boot snapshot %s\n", boot_file);
+        }
+
         // make render progress.
         advance_vdp();
+
+        // end of a replay: report the time taken and the final state.
+        if (input_replay_done()) {
+            Uint32 ms = SDL_GetTicks() - replay_time;
+            uint32_t frames = BusStats.frame - replay_frame;
+            printf("replay %s: %u frames in %u ms (%.1f fps), state %016llx\n", replay_file,
+                frames, ms, ms ? frames * 1000.0 / ms : 0.0, (unsigned long long)input_state_hash());
+            running = 0;
+        }
+
+        // rewind history: one record per frame.
+        if (BusStats.frame != rewind_frame) {
+            rewind_frame = BusStats.frame;
+            rewind_capture();
+        }
+
+        // run-ahead: once per frame, at the start of VBlank.
+        if (ahead && BusStats.frame != ahead_frame) {
+            ahead_frame = BusStats.frame;
+            run_ahead(ahead_frames);
+        }
     }
 
-    final_render();
+    input_close();
+    lat_report();
+    disk_close();
+    sync_binary_files(1);
+    if (iolog_file) iolog_dump(iolog_file);
+    stats_close();
+    if (!headless) final_render();
     return 0;
 }
 
@@ -0,0 +1,166 @@
+// Robo Emulator - Save States
+
+// A state is a 16-byte header followed by tagged sections, each written by the
+// module that owns the state (ula_state, vdp_state) using the same walk for
+// size, save, check and load. Values are stored in host byte order.
+// ROM images, cartridges and options are configuration: they are not saved,
+// and a state only loads into a machine with the same banks fitted.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "header.h"
+
+enum state_fmt {
+    STATE_VERSION  = 2,       // header: "ROBOSTAT", u32 version, u32 size
+};
+
+// copy `n` bytes to or from the buffer, depending on the mode.
+void state_bytes(state_buf* s, void* p, size_t n) {
+    if (s->mode != STATE_SIZE) {
+        if (s->fail || s->pos + n > s->cap) {
+            s->fail = 1;
+            return;
+        }
+        if (s->mode == STATE_SAVE) memcpy(s->buf + s->pos, p, n);
+        else if (s->mode == STATE_LOAD) memcpy(p, s->buf + s->pos, n);
+    }
+    s->pos += n;
+}
+
+// like state_bytes, but also reads when checking: for locals that get validated.
+void state_local(state_buf* s, void* p, size_t n) {
+    uint8_t mode = s->mode;
+    if (mode == STATE_CHECK) s->mode = STATE_LOAD;
+    state_bytes(s, p, n);
+    s->mode = mode;
+}
+
+// section marker: catches a state from a different build before anything loads.
+void state_tag(state_buf* s, const char tag[4]) {
+    char got[4];
+    memcpy(got, tag, 4);
+    state_local(s, got, 4);
+    if (s->mode >= STATE_CHECK && memcmp(got, tag, 4)) s->fail = 1;
+}
+
+static void cpu_state(state_buf* s) {
+    state_tag(s, "CPU ");
+    STATE(s, pc);
+    STATE(s, sp);
+    STATE(s, a);
+    STATE(s, x);
+    STATE(s, y);
+    STATE(s, status);
+    STATE(s, pend_irq);
+    STATE(s, instructions);
+    STATE(s, clockticks6502);
+    STATE(s, clockgoal6502);
+}
+
+static void state_walk(state_buf* s) {
+    char magic[8];
+    uint32_t version = STATE_VERSION;
+    uint32_t size = (uint32_t)s->cap;
+    memcpy(magic, "ROBOSTAT", 8);
+    state_local(s, magic, 8);
+    state_local(s, &version, sizeof(version));
+    state_local(s, &size, sizeof(size));
+    if (s->mode >= STATE_CHECK && (memcmp(magic, "ROBOSTAT", 8) || version != STATE_VERSION || size != s->cap)) {
+        s->fail = 1;
+        return;
+    }
+    cpu_state(s);
+    ula_state(s);
+    vdp_state(s);
+    disk_state(s);
+    state_tag(s, "END ");
+}
+
+// bytes needed to save the current state (changes as expansion RAM is allocated)
+size_t state_size_part(uint8_t skip) {
+    state_buf s = { 0, 0, 0, STATE_SIZE, 0, skip };
+    state_walk(&s);
+    return s.pos;
+}
+
+// returns the bytes written, or 0 if `cap` is too small.
+size_t state_save_part(uint8_t* buf, size_t cap, uint8_t skip) {
+    size_t size = state_size_part(skip);
+    if (size > cap) return 0;
+    state_buf s = { buf, 0, size, STATE_SAVE, 0, skip };
+    state_walk(&s);
+    return s.fail ? 0 : s.pos;
+}
+
+// validates the whole state first, so a bad state leaves the machine untouched.
+int state_load_part(const uint8_t* buf, size_t len, uint8_t skip) {
+    state_buf s = { (uint8_t*)buf, 0, len, STATE_CHECK, 0, skip };
+    state_walk(&s);
+    if (s.fail || s.pos != len) return 0;
+    s.pos = 0;
+    s.mode = STATE_LOAD;
+    state_walk(&s);
+    return !s.fail;
+}
+
+size_t state_size() {
+    return state_size_part(STATE_ALL);
+}
+
+size_t state_save(uint8_t* buf, size_t cap) {
+    return state_save_part(buf, cap, STATE_ALL);
+}
+
+int state_load(const uint8_t* buf, size_t len) {
+    return state_load_part(buf, len, STATE_ALL);
+}
+
+// A file holds one state, optionally preceded by a 64-bit key (boot cache).
+static int state_write(const char* path, const uint64_t* key) {
+    size_t cap = state_size();
+    uint8_t* buf = malloc(cap);
+    if (!buf) return 0;
+    size_t size = state_save(buf, cap);
+    FILE* f = fopen(path, "wb");
+    int ok = f && size && (!key || fwrite(key, sizeof(*key), 1, f) == 1) && fwrite(buf, 1, size, f) == size;
+    if (f && fclose(f)) ok = 0;
+    free(buf);
+    return ok;
+}
+
+static int state_read(const char* path, const uint64_t* key) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+    uint64_t got = 0;
+    if (key && (fread(&got, sizeof(got), 1, f) != 1 || got != *key)) {
+        fclose(f);
+        return 0;
+    }
+    long at = ftell(f);
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f) - at;
+    fseek(f, at, SEEK_SET);
+    uint8_t* buf = len > 0 ? malloc(len) : 0;
+    int ok = buf && fread(buf, 1, len, f) == (size_t)len && state_load(buf, len);
+    fclose(f);
+    free(buf);
+    return ok;
+}
+
+int state_save_file(const char* path) {
+    return state_write(path, 0);
+}
+
+int state_load_file(const char* path) {
+    return state_read(path, 0);
+}
+
+// Boot cache: only loads if `key` (ula_config_hash) matches the one it was saved with.
+int state_save_boot(const char* path, uint64_t key) {
+    return state_write(path, &key);
+}
+
+int state_load_boot(const char* path, uint64_t key) {
+    return state_read(path, &key);
+}
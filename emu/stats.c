@@ -0,0 +1,119 @@
+// Robo Emulator - Bus Statistics
+
+// Counters are bumped in ula.c and render.c; stats_frame() is called at the
+// start of VBlank to write one row per frame (CSV or JSON lines) and clear them.
+// stats_report() prints totals since power-on.
+
+#include <stdio.h>
+#include <string.h>
+#include "header.h"
+
+enum stats_const {
+    STATS_PORT0 = 0x10,   // first port reported ($D0; $C0-$CF are unassigned)
+};
+
+bus_stats BusStats;
+static bus_stats BusTotal;
+static FILE* StatsFile = 0;
+static uint8_t StatsJSON = 0;
+
+static const char* stats_mode_name[8] = {
+    "copy", "fill", "masked", "altfill", "apa", "palette", "sprite", "sprclr"
+};
+
+int stats_open(const char* path) {
+    size_t len = strlen(path);
+    StatsFile = fopen(path, "w");
+    if (!StatsFile) return 0;
+    StatsJSON = (len >= 5 && !strcmp(path + len - 5, ".json"));
+    if (!StatsJSON) {
+        fprintf(StatsFile, "frame");
+        for (int m=0; m<8; m++) fprintf(StatsFile, ",dma_%s", stats_mode_name[m]);
+        fprintf(StatsFile, ",interlock,ylin,hdma,banks,vdp_syncs");
+        for (int p=STATS_PORT0; p<64; p++) fprintf(StatsFile, ",rd_%02X", 0xC0+p);
+        for (int p=STATS_PORT0; p<64; p++) fprintf(StatsFile, ",wr_%02X", 0xC0+p);
+        fprintf(StatsFile, "\n");
+    }
+    return 1;
+}
+
+// JSON: only non-zero ports, as {"D5":12,...}
+static void stats_json_ports(const char* name, const uint32_t* counts) {
+    const char* sep = "";
+    fprintf(StatsFile, ",\"%s\":{", name);
+    for (int p=STATS_PORT0; p<64; p++) {
+        if (counts[p]) {
+            fprintf(StatsFile, "%s\"%02X\":%u", sep, 0xC0+p, counts[p]);
+            sep = ",";
+        }
+    }
+    fprintf(StatsFile, "}");
+}
+
+static void stats_write(const bus_stats* s) {
+    if (StatsJSON) {
+        fprintf(StatsFile, "{\"frame\":%u,\"dma\":{", s->frame);
+        for (int m=0; m<8; m++) fprintf(StatsFile, "%s\"%s\":%u", m ? "," : "", stats_mode_name[m], s->dma_bytes[m]);
+        fprintf(StatsFile, "},\"interlock\":%u,\"ylin\":%u,\"hdma\":%u,\"banks\":%u,\"vdp_syncs\":%u",
+            s->interlock_cycles, s->ylin_cycles, s->hdma_cycles, s->bank_switches, s->vdp_syncs);
+        stats_json_ports("rd", s->io_reads);
+        stats_json_ports("wr", s->io_writes);
+        fprintf(StatsFile, "}\n");
+    } else {
+        fprintf(StatsFile, "%u", s->frame);
+        for (int m=0; m<8; m++) fprintf(StatsFile, ",%u", s->dma_bytes[m]);
+        fprintf(StatsFile, ",%u,%u,%u,%u,%u", s->interlock_cycles, s->ylin_cycles, s->hdma_cycles, s->bank_switches, s->vdp_syncs);
+        for (int p=STATS_PORT0; p<64; p++) fprintf(StatsFile, ",%u", s->io_reads[p]);
+        for (int p=STATS_PORT0; p<64; p++) fprintf(StatsFile, ",%u", s->io_writes[p]);
+        fprintf(StatsFile, "\n");
+    }
+}
+
+static void stats_add(bus_stats* t, const bus_stats* s) {
+    for (int m=0; m<8; m++) t->dma_bytes[m] += s->dma_bytes[m];
+    t->interlock_cycles += s->interlock_cycles;
+    t->ylin_cycles += s->ylin_cycles;
+    t->hdma_cycles += s->hdma_cycles;
+    t->bank_switches += s->bank_switches;
+    t->vdp_syncs += s->vdp_syncs;
+    for (int p=0; p<64; p++) {
+        t->io_reads[p] += s->io_reads[p];
+        t->io_writes[p] += s->io_writes[p];
+    }
+}
+
+// called once per frame, at the start of VBlank
+void stats_frame() {
+    if (StatsFile) stats_write(&BusStats);
+    stats_add(&BusTotal, &BusStats);
+    // clear for the next frame
+    uint32_t frame = BusStats.frame + 1;
+    memset(&BusStats, 0, sizeof(BusStats));
+    BusStats.frame = BusTotal.frame = frame;
+}
+
+// print totals since power-on (including the current frame so far)
+void stats_report() {
+    bus_stats total = BusTotal;
+    const bus_stats* s = &total;
+    stats_add(&total, &BusStats);
+    printf("bus stats: %u frames\n", s->frame);
+    for (int m=0; m<8; m++) {
+        if (s->dma_bytes[m]) printf("  dma %-8s %10u bytes\n", stats_mode_name[m], s->dma_bytes[m]);
+    }
+    printf("  interlock    %10u cycles\n", s->interlock_cycles);
+    printf("  ylin wait    %10u cycles\n", s->ylin_cycles);
+    printf("  hdma         %10u cycles\n", s->hdma_cycles);
+    printf("  bank switch  %10u\n", s->bank_switches);
+    printf("  vdp syncs    %10u\n", s->vdp_syncs);
+    for (int p=STATS_PORT0; p<64; p++) {
+        if (s->io_reads[p] || s->io_writes[p]) {
+            printf("  port $%02X  rd %10u  wr %10u\n", 0xC0+p, s->io_reads[p], s->io_writes[p]);
+        }
+    }
+}
+
+void stats_close() {
+    if (StatsFile) fclose(StatsFile);
+    StatsFile = 0;
+}
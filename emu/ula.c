@@ -1,7 +1,16 @@
 #include "header.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 enum io_reg {
+    // Expansion port (disk interface)
+    IO_DSK0    = 0xC0,   // disk sector low     (advances past each command)
+    IO_DSK1    = 0xC1,   // disk sector mid
+    IO_DSK2    = 0xC2,   // disk sector high    (directory: file number, 0=catalog)
+    IO_DSKN    = 0xC3,   // disk sector count   (0=256)
+    IO_DSKC    = 0xC4,   // disk command        (write: 1=read to DMA_Dst, 2=write from DMA_Src; read: status)
+
     // DMA
     IO_SRCL    = 0xD0,   // DMA src low         (DMA uses current BNK8/BNKC mapping)
     IO_SRCH    = 0xD1,   // DMA src high        (BASIC must handle bank-crossing due to non-contiguous RAM)
@@ -15,7 +24,7 @@ enum io_reg {
     IO_AINC    = 0xD9,   // APA increment       (read: second byte of indirect jump; write: increment DST += 640)
     IO_BNK8    = 0xDA,   // Bank switch $8000   (low 6 bits)
     IO_BNKC    = 0xDB,   // Bank switch $C000   (low 6 bits)
-    IO____1    = 0xDC,   // 
+    IO_HDMA    = 0xDC,   // HDMA table page     (low 4 bits: table at page*256 in the low 4K of RAM)
     IO____2    = 0xDD,   // 
     IO_KEYB    = 0xDE,   // Keyboard scan (write: set row; read: scan column) (0x80|zp: DMA fastload 5 bytes)
     IO_MULW    = 0xDF,   // Booth multiplier (write {AL,AH,BL,BH} read {RL,RH})
@@ -46,7 +55,7 @@ enum io_reg {
     IO_FINH    = 0xF4,   // horizontal fine scroll (top 3 bits)
     IO_FINV    = 0xF5,   // vertical fine scroll   (top 3 bits)
     IO_VCTL    = 0xF6,   // video control          (7:APA 6:Grey 5:LMask 4:RMask 3-2:VCount 1-0:Divider)
-    IO_VENA    = 0xF7,   // video enable           (7:VSyncI 6:VCmpI 5:HSyncI 4:PwrLED 3:CapLED 2:HDMA_En 1:Spr_En 0:BG_En)
+    IO_VENA    = 0xF7,   // video enable           (7:VSyncI 6:VCmpI 5:HSyncI 4:HDMA_En 3:PwrLED 2:CapLED 1:Spr_En 0:BG_En)
     IO_VSTA    = 0xF8,   // interrupt status       (7:VSyncI 6:VCmpI 5:HSyncI)  (read:status / write:clear)
     IO_VMAP    = 0xF9,   // name table size        (4:4 width 32,64,128,256; height 32,64,128,256)
     IO_VTAB    = 0xFA,   // name table base        (high byte)
@@ -57,7 +66,35 @@ enum io_reg {
     IO_SPRD    = 0xFF,   // sprite data R/W        (direct sprite-memory data, increments address)
 };
 
+// VDP sync class of each IO port ($C0-$FF). The VDP is caught up before a
+// read that observes VDP state or a write that affects it (including any
+// VRAM, palette or sprite DMA); all other ports leave it to catch up later.
+enum io_sync {
+    SYNC_RD = 1,    // read observes VDP state (counters, status, VRAM interlock)
+    SYNC_WR = 2,    // write affects VDP state (registers, VRAM/palette/sprite memory)
+};
+static const uint8_t IOSync[64] = {
+    [IO_DSKC-0xC0] = SYNC_WR,           // disk DMA (VRAM/PAL/SPR writes)
+    [IO_DRUN-0xC0] = SYNC_WR,           // DMA run (VRAM interlock, VRAM/PAL/SPR writes)
+    [IO_DDRW-0xC0] = SYNC_RD|SYNC_WR,   // DMA data R/W (VRAM interlock)
+    [IO_YLIN-0xC0] = SYNC_RD|SYNC_WR,   // V-counter; wait for VBlank
+    [IO_YCMP-0xC0] = SYNC_WR,
+    [IO_SCRH-0xC0] = SYNC_WR,
+    [IO_SCRV-0xC0] = SYNC_WR,
+    [IO_FINH-0xC0] = SYNC_WR,
+    [IO_FINV-0xC0] = SYNC_WR,
+    [IO_VCTL-0xC0] = SYNC_WR,
+    [IO_VENA-0xC0] = SYNC_WR,           // interrupt enables
+    [IO_VSTA-0xC0] = SYNC_RD|SYNC_WR,   // interrupt status
+    [IO_VMAP-0xC0] = SYNC_WR,
+    [IO_VTAB-0xC0] = SYNC_WR,
+    [IO_VBNK-0xC0] = SYNC_RD|SYNC_WR,
+    [IO_PALD-0xC0] = SYNC_WR,
+    [IO_SPRD-0xC0] = SYNC_WR,
+};
+
 uint8_t OpenBus[16*1024] = { 0xE1 };
+static uint8_t LazyRAM[16*1024];         // reads of unwritten expansion RAM (never written)
 uint8_t SysROM[16*1024];
 uint8_t MainRAM_0[16*1024];
 uint8_t MainRAM_1[16*1024];
@@ -65,6 +102,7 @@ uint8_t CartRAM[16*1024];
 uint8_t VRAM[VRAM_SIZE];
 uint8_t PAL_RAM[PAL_SIZE];
 uint8_t SPR_RAM[SPR_SIZE];
+uint8_t PageDirty[PAGE_COUNT];        // 256-byte pages written since rewind_capture (enum page_map)
 
 /*vid*/ uint8_t  VidYCmp  = 0xE8;    // 8-bit Y-line compare register
 /*vid*/ uint8_t  VidScrH  = 0x2F;    // 3-bit horizontal tile scroll
@@ -85,14 +123,42 @@ static uint8_t  DMA_Ctl   = 0x33;     // 8-bit register
 static uint8_t  DMA_Run   = 0x00;     // 8-bit counter          -- reset to 0x00 (Stop DMA)
 static uint8_t  DMA_DL    = 0x77;     // 8-bit [FILL] data latch
 static uint8_t  DMA_Table = 0x55;     // 8-bit [TABLE] register
-static uint8_t  Bank8     = 0x05;     // 4-bit register (0-15)
-static uint8_t  BankC     = 0x00;     // 4-bit register (0-15)  -- reset to 0x00 (ROM bank 0)
+static uint8_t  Bank8     = 0x05;     // 6-bit register (0-63)
+static uint8_t  BankC     = 0x00;     // 6-bit register (0-63)  -- reset to 0x00 (ROM bank 0)
 static uint8_t  KbdCol    = 0x03;     // 4-bit register (0-15)
+static uint16_t MulA      = 0x1234;   // 16-bit multiplier operand A
+static uint16_t MulB      = 0x5678;   // 16-bit multiplier operand B
+static uint16_t MulR      = 0x9ABC;   // 16-bit product (low 16 bits of A*B)
+static uint8_t  MulWr     = 0;        // 2-bit write sequencer {AL,AH,BL,BH}
+static uint8_t  MulRd     = 0;        // 1-bit read sequencer {RL,RH}
+static uint32_t MulDone   = 0;        // CPU cycle when the product is ready
+static uint8_t  HdmaPage  = 0x00;     // 4-bit HDMA table page
+static uint16_t HdmaPtr   = 0x000;    // 12-bit HDMA table counter (low 4K of RAM)
+static uint8_t  HdmaWait  = 0x00;     // 8-bit "wait for YLine" register
+static uint8_t  HdmaHalt  = 0;        // 1-bit latch (waiting for HdmaWait)
+static uint8_t  HdmaBusy  = 0;        // internal: HDMA is writing IO (VDP is in sync)
+static uint8_t  CpuStall  = 0;        // internal: in a YLIN/interlock stall (HDMA takes idle cycles)
+
+uint8_t HwAccel = 1;                  // emulate the Booth multiplier and DMA fastload
+uint32_t KbdReads = 0;                // IO_KEYB reads since power-on (the ROM scans once booted)
+
+enum accel_timing {
+    MUL_CYCLES      = 16,     // radix-2 Booth: one CPU cycle per multiplier bit
+    FASTLOAD_CYCLES = 5,      // 5 bytes, one zero-page read per CPU cycle
+    HDMA_ENTRIES    = 4,      // table entries per HBLANK
+    HDMA_CYCLES     = 3,      // CPU cycles per entry (read a, read d, write)
+};
 
 static uint16_t DMA_sinc  = 0x01;     // internal: DMA src increment
 static uint16_t DMA_dinc  = 0x01;     // internal: DMA dest increment
 
-static uint8_t* BankMap[16] = {
+enum bank_wr {
+    BANK_RO        = 0,       // ROM or open bus
+    BANK_RW        = 1,       // RAM
+    BANK_LAZY      = 2,       // RAM, allocated on first write (reads LazyRAM until then)
+};
+
+static uint8_t* BankMap[64] = {
     // ROM area
     SysROM,                // System ROM
     OpenBus,               // Reserved for System ROM
@@ -112,9 +178,16 @@ static uint8_t* BankMap[16] = {
     OpenBus,
     OpenBus,
     OpenBus,
+    // Expansion memory (up to 768K, see ula_map_ram)
+    OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus,
+    OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus,
+    OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus,
+    OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus,
+    OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus,
+    OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus, OpenBus,
 };
 
-static uint8_t BankMapWR[16] = {
+static uint8_t BankMapWR[64] = {   // enum bank_wr (banks 16-63 default to 0)
     // ROM area
     0,                     // System ROM
     0,                     // Reserved for System ROM
@@ -150,9 +223,170 @@ static uint8_t RAMViewWR[4] = {
     0,  // Read only
 };
 
+static uint16_t RAMViewPage[4] = {   // first PageDirty page of each view
+    PAGE_MAIN,
+    PAGE_MAIN+64,
+    PAGE_BANK+5*64,
+    PAGE_BANK,
+};
+
+// refresh the $8000/$C000 views after BankMap changes
+static void bank_views() {
+    RAMView[2] = BankMap[Bank8];     // [2] is the slot at $8000
+    RAMViewWR[2] = BankMapWR[Bank8];
+    RAMViewPage[2] = PAGE_BANK + Bank8*64;
+    RAMView[3] = BankMap[BankC];     // [3] is the slot at $C000
+    RAMViewWR[3] = BankMapWR[BankC];
+    RAMViewPage[3] = PAGE_BANK + BankC*64;
+}
+
+// Host memory for a PageDirty page, or 0 if it cannot be written (ROM, open bus, unwritten lazy RAM).
+uint8_t* ula_page(unsigned page) {
+    if (page < PAGE_BANK) {
+        return (page < PAGE_MAIN+64 ? MainRAM_0 : MainRAM_1) + ((page & 63) << 8);
+    } else if (page < PAGE_VRAM) {
+        unsigned bank = (page - PAGE_BANK) >> 6;
+        return (BankMapWR[bank] == BANK_RW) ? BankMap[bank] + ((page & 63) << 8) : 0;
+    } else if (page < PAGE_PAL) {
+        return VRAM + ((page - PAGE_VRAM) << 8);
+    } else if (page == PAGE_PAL) {
+        return PAL_RAM;
+    } else if (page == PAGE_SPR) {
+        return SPR_RAM;
+    }
+    return 0;
+}
+
+// Install a 16K bank: a cartridge or expansion image (0 = open bus).
+void ula_map_bank(unsigned bank, uint8_t* mem, uint8_t writable) {
+    if (bank >= 64) return;
+    BankMap[bank] = mem ? mem : OpenBus;
+    BankMapWR[bank] = mem ? writable : BANK_RO;
+    bank_views();
+}
+
+// Make a 16K bank expansion RAM; host memory is allocated on first write.
+void ula_map_ram(unsigned bank) {
+    if (bank >= 64) return;
+    BankMap[bank] = LazyRAM;
+    BankMapWR[bank] = BANK_LAZY;
+    bank_views();
+}
+
+// FNV-1a hash of the fitted ROM, cartridges, RAM banks and options (for the boot cache).
+uint64_t ula_config_hash() {
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (unsigned bank=0; bank<64; bank++) {
+        const uint8_t* mem = BankMap[bank];
+        size_t n = (mem == OpenBus || mem == LazyRAM) ? 0 : 16*1024;
+        h = (h ^ BankMapWR[bank]) * 0x100000001B3ull;
+        for (size_t i=0; i<n; i++) h = (h ^ mem[i]) * 0x100000001B3ull;
+    }
+    h = (h ^ HwAccel) * 0x100000001B3ull;
+    return h;
+}
+
+// Bank selected at an address, or 0xFF for the fixed RAM at $0000-$7FFF.
+uint8_t ula_bank_at(uint16_t address) {
+    if (address < 0x8000) return 0xFF;
+    return (address < 0xC000) ? Bank8 : BankC;
+}
+
+// Allocate host memory for a lazy RAM bank.
+static uint8_t bank_alloc(unsigned bank) {
+    uint8_t* mem = calloc(1, 16*1024);
+    if (!mem) {
+        printf("out of memory for bank %d\n", bank);
+        BankMapWR[bank] = BANK_RO;
+        bank_views();
+        return 0;
+    }
+    BankMap[bank] = mem;
+    BankMapWR[bank] = BANK_RW;
+    bank_views();
+    return 1;
+}
+
+// Is the view slot writable? Allocates a lazy RAM bank on its first write.
+static uint8_t view_writable(unsigned page) {
+    uint8_t wr = RAMViewWR[page];
+    if (wr == BANK_LAZY) {
+        return bank_alloc((page == 2) ? Bank8 : BankC);
+    }
+    return wr;
+}
+
+// Save state: registers, RAM, and the contents of every RAM bank.
+// Lazy banks that were never written are saved as a kind byte only.
+void ula_state(state_buf* s) {
+    state_tag(s, "ULA ");
+    STATE(s, VidYCmp);
+    STATE(s, VidScrH);
+    STATE(s, VidScrV);
+    STATE(s, VidFinH);
+    STATE(s, VidFinV);
+    STATE(s, VidCtl);
+    STATE(s, VidEna);
+    STATE(s, VidSta);
+    STATE(s, NameSize);
+    STATE(s, NameBase);
+    STATE(s, PalAddr);
+    STATE(s, SprAddr);
+    STATE(s, DMA_Src);
+    STATE(s, DMA_Dst);
+    STATE(s, DMA_Ctl);
+    STATE(s, DMA_Run);
+    STATE(s, DMA_DL);
+    STATE(s, DMA_Table);
+    STATE(s, DMA_sinc);
+    STATE(s, DMA_dinc);
+    STATE(s, Bank8);
+    STATE(s, BankC);
+    STATE(s, KbdCol);
+    STATE(s, MulA);
+    STATE(s, MulB);
+    STATE(s, MulR);
+    STATE(s, MulWr);
+    STATE(s, MulRd);
+    STATE(s, MulDone);
+    STATE(s, HdmaPage);
+    STATE(s, HdmaPtr);
+    STATE(s, HdmaWait);
+    STATE(s, HdmaHalt);
+    if (s->mode == STATE_LOAD) bank_views();   // Bank8/BankC changed (also without RAM)
+    if (s->skip & STATE_NO_RAM) return;
+    STATE(s, MainRAM_0);
+    STATE(s, MainRAM_1);
+    STATE(s, VRAM);
+    STATE(s, PAL_RAM);
+    STATE(s, SPR_RAM);
+    state_tag(s, "BANK");
+    for (unsigned bank=0; bank<64; bank++) {
+        uint8_t kind = BankMapWR[bank];
+        state_local(s, &kind, 1);
+        if (s->fail) return;
+        if (s->mode >= STATE_CHECK && (kind == BANK_RO) != (BankMapWR[bank] == BANK_RO)) {
+            s->fail = 1;     // different banks fitted
+            return;
+        }
+        if (s->mode == STATE_LOAD) {
+            if (kind == BANK_RW && BankMapWR[bank] == BANK_LAZY && !bank_alloc(bank)) {
+                s->fail = 1;
+                return;
+            }
+            if (kind == BANK_LAZY && BankMapWR[bank] == BANK_RW) {
+                memset(BankMap[bank], 0, 16*1024);   // written since the save
+            }
+        }
+        if (kind == BANK_RW) state_bytes(s, BankMap[bank], 16*1024);
+    }
+    if (s->mode == STATE_LOAD) bank_views();
+}
+
 void dma_interlock();
 uint8_t dma_read_cycle();
 void dma_write_cycle();
+static void dma_run();
 
 static void dma_update_inc() {
     int width = 1 << (6+(NameSize>>2)); // 64/128/256/512
@@ -163,13 +397,34 @@ static void dma_update_inc() {
         ((DMA_Ctl & dma_ctl_vertical) ? width : 1);              //  vert : 1
 }
 
+// Catch up the VDP if this IO access needs it (see IOSync), or if the VDP
+// would have raised an interrupt by now, so IRQ timing is unchanged.
+// Logged ports sync too, so the IO log records the current line position.
+static void io_sync_vdp(uint16_t address, uint8_t need) {
+    if (HdmaBusy) return;                // called from the VDP (hdma_line)
+    if ((IOSync[address & 0x3F] & need) || (VidEna & VENA_HDMA_En) ||
+        (IoLogMask & ((uint64_t)1 << (address & 0x3F))) ||
+        vdp_irq_clk() <= ((uint64_t)clockticks6502 * 9) / 2) {
+        advance_vdp();
+    }
+}
+
 static uint8_t ula_io_read(uint16_t address) {
-    // catch up the VDP before reading IO
-    advance_vdp();
+    // catch up the VDP before reading IO (if it matters)
+    io_sync_vdp(address, SYNC_RD);
+    BusStats.io_reads[address & 0x3F]++;
     // open bus value
     uint8_t value = 0xEE;
     // now read the IO port
     switch (address) {
+        // C-page
+        // (open bus unless a disk is fitted)
+        case IO_DSK0: if (DiskFitted) value = DiskSec[0]; break; // $C0: disk sector low
+        case IO_DSK1: if (DiskFitted) value = DiskSec[1]; break; // $C1: disk sector mid
+        case IO_DSK2: if (DiskFitted) value = DiskSec[2]; break; // $C2: disk sector high
+        case IO_DSKN: if (DiskFitted) value = DiskCnt;    break; // $C3: disk sector count
+        case IO_DSKC: if (DiskFitted) value = DiskSta;    break; // $C4: disk status
+
         // D-page
         case IO_SRCL: value = DMA_Src & 0xFF; break; // $D0: DMA src low
         case IO_SRCH: value = DMA_Src >> 8;   break; // $D1: DMA src high
@@ -182,6 +437,7 @@ static uint8_t ula_io_read(uint16_t address) {
             // DMA Read cycle, as CPU memory access.
             dma_interlock();
             value = dma_read_cycle();
+            BusStats.dma_bytes[DMA_Ctl & DMA_Mode]++;
             break;
         }
         case IO_DJMP: {                              // $D8: DMA jump indirect (read low byte)
@@ -201,13 +457,25 @@ static uint8_t ula_io_read(uint16_t address) {
             value = RAMView[entry >> 14][entry & 0x3FFF];
             break;
         }   
-        case IO_BNK8: value = Bank8; break;          // $DA: Bank switch 0x8000  (low 4 bits)
-        case IO_BNKC: value = BankC; break;          // $DB: Bank switch 0xC000  (low 4 bits)
+        case IO_BNK8: value = Bank8; break;          // $DA: Bank switch 0x8000  (low 6 bits)
+        case IO_BNKC: value = BankC; break;          // $DB: Bank switch 0xC000  (low 6 bits)
+        case IO_HDMA: value = HdmaPage; break;       // $DC: HDMA table page
         case IO_KEYB: {                              // $DE: Keyboard scan (read: scan column)
-            value = scanKeyCol(KbdCol);
+            value = input_key(KbdCol);
+            KbdReads++;
+            if (LatState) lat_scan(KbdCol, value);
+            break;
+        }
+        case IO_MULW: {                              // $DF: Booth multiplier (read {RL,RH})
+            if (!HwAccel) break;
+            // reading before the product is ready stalls the CPU
+            if ((int32_t)(MulDone - clockticks6502) > 0) {
+                clockticks6502 = MulDone;
+            }
+            value = MulRd ? (MulR >> 8) : (MulR & 0xFF);
+            MulRd ^= 1;
             break;
         }
-        case IO_MULW: break;                         // $DF: Booth multiplier? (write {AL,AH,BL,BH} read {RL,RH})
 
         // E-page
         case IO_TON0:       // $E0: PSG Ch.0 tone
@@ -259,7 +527,7 @@ static uint8_t ula_io_read(uint16_t address) {
         case IO_VCTL:       // $F6: video control          (7:APA 6:Grey 5:Double 4:HCount 3-2:VCount 1-0:Divider) (see below)
             value = VidCtl;
             break;
-        case IO_VENA:       // $F7: interrupt enable       (7:VSync 6:VCmp 5:HSync 3:BG_En 2:Spr_En 1:HDMA_En)
+        case IO_VENA:       // $F7: interrupt enable       (7:VSync 6:VCmp 5:HSync 4:HDMA_En 3:PwrLED 2:CapLED 1:Spr_En 0:BG_En)
             value = VidEna;
             break;
         case IO_VSTA:       // $F8: interrupt status/clear   (7:VSync 6:VCmp 5:HSync)  (write:clear)
@@ -289,15 +557,34 @@ static uint8_t ula_io_read(uint16_t address) {
             SprAddr++;                    // 8-bit register
             break;        
     }
-    // printf("IO Read: [$%02X] -> $%02X\n", address, value);
+    if (IoLogMask & ((uint64_t)1 << (address & 0x3F))) {
+        iolog_event(address, value, IOLOG_RD);
+    }
     return value;
 }
 
 static void ula_io_write(uint16_t address, uint8_t value) {
-    // catch up the VDP before reading IO
-    advance_vdp();
+    // catch up the VDP before writing IO (if it matters)
+    io_sync_vdp(address, SYNC_WR);
+    BusStats.io_writes[address & 0x3F]++;
+    if (IoLogMask & ((uint64_t)1 << (address & 0x3F))) {
+        iolog_event(address, value, IOLOG_WR);
+    }
     // now write the IO value
     switch (address) {
+        // C-page
+        case IO_DSK0:       // $C0: disk sector low
+        case IO_DSK1:       // $C1: disk sector mid
+        case IO_DSK2:       // $C2: disk sector high
+            if (DiskFitted) DiskSec[address - IO_DSK0] = value;
+            break;
+        case IO_DSKN:       // $C3: disk sector count
+            if (DiskFitted) DiskCnt = value;
+            break;
+        case IO_DSKC:       // $C4: disk command (runs to completion)
+            if (DiskFitted) disk_command(value);
+            break;
+
         // D-page
         case IO_SRCL:       // $D0: DMA src low
             DMA_Src = (DMA_Src & 0xFF00) | value; // 16-bit register, set low 8 bits
@@ -317,6 +604,12 @@ static void ula_io_write(uint16_t address, uint8_t value) {
             break;
         case IO_DRUN: {                      // $D5: DMA count
             DMA_Run = value;                 // 8-bit register
+            if ((DMA_Ctl & DMA_Mode) <= DMA_AltFill ||
+                ((DMA_Ctl & DMA_Mode) == DMA_APA && !(DMA_Ctl & (dma_ctl_to_vram|dma_ctl_from_vram)))) {
+                dma_run();                   // Copy/Fill/Masked/AltFill and RAM APA in bulk
+                break;
+            }
+            BusStats.dma_bytes[DMA_Ctl & DMA_Mode] += DMA_Run ? DMA_Run : 256;
             do {
                 dma_interlock();             // HW gates each DMA cycle
                 dma_read_cycle();
@@ -337,6 +630,7 @@ static void ula_io_write(uint16_t address, uint8_t value) {
                 // Delayed DMA cycle on the next SYNC (stalling OP-FETCH)
                 // Latch into TABLE, because APA Cycle uses DL.
                 DMA_Table = value;
+                BusStats.dma_bytes[DMA_Ctl & DMA_Mode]++;
                 dma_interlock();
                 dma_read_cycle();
                 clockticks6502++;            // +1 RAM cycle (one CPU cycle)
@@ -346,6 +640,7 @@ static void ula_io_write(uint16_t address, uint8_t value) {
             } else {
                 // DMA Write cycle, as CPU memory access.
                 DMA_DL = value;              // latch into DL (transparent latch)
+                BusStats.dma_bytes[DMA_Ctl & DMA_Mode]++;
                 dma_interlock();
                 dma_write_cycle();
                 advance_vdp();               // in case DMA write affects next pixel (XXX can it?)
@@ -361,19 +656,48 @@ static void ula_io_write(uint16_t address, uint8_t value) {
             break;
         }
         case IO_BNK8:                        // $DA: Bank switch $8000
-            Bank8 = value & 0xF;             // 4-bit register
-            RAMView[2] = BankMap[Bank8];     // update active-bank table
-            RAMViewWR[2] = BankMapWR[Bank8]; // [2] is the slot at $8000
+            Bank8 = value & 0x3F;            // 6-bit register
+            bank_views();                    // update active-bank table
+            BusStats.bank_switches++;
             break;
         case IO_BNKC:                        // $DB: Bank switch $C000
-            BankC = value & 0xF;             // 4-bit register
-            RAMView[3] = BankMap[Bank8];     // update active-bank table
-            RAMViewWR[3] = BankMapWR[Bank8]; // [3] is the slot at $C000
+            BankC = value & 0x3F;            // 6-bit register
+            bank_views();                    // update active-bank table
+            BusStats.bank_switches++;
+            break;
+        case IO_HDMA:                        // $DC: HDMA table page (takes effect next frame)
+            HdmaPage = value & 0xF;          // 4-bit register
             break;
         case IO_KEYB:                        // $DE: set keyboard scan column (4-bit)
+            if ((value & 0x80) && HwAccel) {
+                // DMA fastload: load SRCL,SRCH,DSTL,DSTH,DCTL from zero page (8-aligned)
+                const uint8_t* zp = &MainRAM_0[value & 0x78];
+                DMA_Src = zp[0] | (zp[1] << 8);
+                DMA_Dst = zp[2] | (zp[3] << 8);
+                DMA_Ctl = zp[4];
+                dma_update_inc();
+                clockticks6502 += FASTLOAD_CYCLES; // stalls for one cycle per byte
+                break;
+            }
             KbdCol = value & 0xF;
             break;
-        case IO_MULW:                        // $DF: Booth multiplier? (write {AL,AH,BL,BH} read {RL,RH})
+        case IO_MULW:                        // $DF: Booth multiplier (write {AL,AH,BL,BH})
+            if (!HwAccel) break;
+            switch (MulWr) {
+                case 0: MulA = (MulA & 0xFF00) | value; break;
+                case 1: MulA = (MulA & 0x00FF) | (value << 8); break;
+                case 2: MulB = (MulB & 0xFF00) | value; break;
+                case 3: {
+                    MulB = (MulB & 0x00FF) | (value << 8);
+                    // writing BH starts the multiply; low 16 bits are the
+                    // same for signed (Booth) and unsigned operands
+                    MulR = (uint16_t)((uint32_t)MulA * MulB);
+                    MulDone = clockticks6502 + MUL_CYCLES;
+                    MulRd = 0;
+                    break;
+                }
+            }
+            MulWr = (MulWr + 1) & 3;
             break;
 
         // E-page
@@ -404,10 +728,15 @@ static void ula_io_write(uint16_t address, uint8_t value) {
 
         // F-page
         case IO_YLIN:       // $F0: current Y-line         (write: wait for VBlank)
-            // Stall the CPU
-            while (!vdp_vblank) {
-                clockticks6502++; // XXX wrong: count VDP cycles until VSync, derive CPU cycles
+            // Stall the CPU to the first cycle in VBlank, in one step
+            // (advance_vdp raises any interrupts along the way)
+            if (!vdp_vblank) {
+                uint32_t stall_from = clockticks6502;
+                clockticks6502 = vdp_cpu_clk(vdp_vblank_clk());
+                BusStats.ylin_cycles += clockticks6502 - stall_from;
+                CpuStall = 1;
                 advance_vdp();
+                CpuStall = 0;
             }
             break;
         case IO_YCMP:       // $F1: compare Y-line         (read/write, $FF won't trigger)
@@ -436,7 +765,7 @@ static void ula_io_write(uint16_t address, uint8_t value) {
         case IO_VCTL:                    // $F6: video control (7:APA 6:Grey 5:Double 4:HCount 3-2:VCount 1-0:Divider) (see below)
             VidCtl = value;
             break;
-        case IO_VENA:                    // $F7: interrupt enable (7:VSync 6:YCmp 5:HSync 3:BG_En 2:Spr_En 1:HDMA_En)
+        case IO_VENA:                    // $F7: interrupt enable (7:VSync 6:YCmp 5:HSync 4:HDMA_En 3:PwrLED 2:CapLED 1:Spr_En 0:BG_En)
             VidEna = value;
             break;
         case IO_VSTA:                    // $F8: interrupt status/clear (7:VSync 6:YCmp 5:HSync)
@@ -457,6 +786,8 @@ static void ula_io_write(uint16_t address, uint8_t value) {
             break;
         case IO_PALD:                    // $FD: palette data R/W
             PAL_RAM[PalAddr] = value;
+            PageDirty[PAGE_PAL] = 1;
+            vdp_palette(PalAddr);
             PalAddr = (PalAddr+1) & (PAL_SIZE-1);
             break;
         case IO_SPRA:                    // $FE: sprite address
@@ -464,19 +795,66 @@ static void ula_io_write(uint16_t address, uint8_t value) {
             break;
         case IO_SPRD:                     // $FF: sprite data R/W
             SPR_RAM[SprAddr & (SPR_SIZE-1)] = value;
+            PageDirty[PAGE_SPR] = 1;
             SprAddr++;                    // 8-bit register
             break;
     }
-    // printf("IO Write: [$%02X] <- $%02X\n", address, value);
 }
 
-void dma_interlock() {
-    if (DMA_Ctl & (dma_ctl_to_vram|dma_ctl_from_vram)) { // HW is indiscriminate!
-        while (vdp_vbusy) {
-            clockticks6502++; // XXX wrong: count VDP cycles until !VBusy, derive CPU cycles
-            advance_vdp();
+// HDMA: called by the VDP at the start of HBLANK on each line while VENA_HDMA_En is set.
+// Runs up to HDMA_ENTRIES table entries from CPU cycle `at` and charges the stolen
+// cycles to the CPU clock. In a stall the CPU clock is already at the stall target,
+// so HDMA only moves it on if it runs past that.
+// Entries are two bytes: [00 nn] wait for YLine nn, [00 FF] HSync interrupt,
+// [aa dd] write dd to IO port $aa ($E0-$FF, except YLIN; others are skipped).
+void hdma_line(uint16_t line, uint32_t at) {
+    if (line == 311) {
+        // last line before the visible area: restart the table
+        HdmaPtr = HdmaPage << 8;
+        HdmaHalt = 0;
+    }
+    if (HdmaHalt) {
+        if (line != HdmaWait) return;
+        HdmaHalt = 0;
+    }
+    unsigned n = 0;
+    HdmaBusy = 1;
+    while (n < HDMA_ENTRIES) {
+        uint8_t a = MainRAM_0[HdmaPtr];
+        uint8_t d = MainRAM_0[(HdmaPtr + 1) & 0xFFF];
+        HdmaPtr = (HdmaPtr + 2) & 0xFFF;     // 12-bit counter
+        n++;
+        if (a == 0) {
+            if (d == 0xFF) {
+                if (VidEna & VENA_HSync) {
+                    VidSta |= VSTA_HSync;
+                    request_irq();
+                }
+            } else if (d != line) {
+                HdmaWait = d;                // resume in HBLANK of line d
+                HdmaHalt = 1;
+                break;
+            }
+        } else if (a >= 0xE0 && a != IO_YLIN) {
+            ula_io_write(a, d);
         }
     }
+    HdmaBusy = 0;
+    BusStats.hdma_cycles += n * HDMA_CYCLES;
+    if (!CpuStall) clockticks6502 += n * HDMA_CYCLES;
+    else if (at + n * HDMA_CYCLES > clockticks6502) clockticks6502 = at + n * HDMA_CYCLES;
+}
+
+void dma_interlock() {
+    if ((DMA_Ctl & (dma_ctl_to_vram|dma_ctl_from_vram)) && vdp_vbusy) { // HW is indiscriminate!
+        // stall to the first CPU cycle at which VBusy has fallen
+        uint32_t stall_from = clockticks6502;
+        clockticks6502 = vdp_cpu_clk(vdp_vbusy_edge());
+        BusStats.interlock_cycles += clockticks6502 - stall_from;
+        CpuStall = 1;
+        advance_vdp();
+        CpuStall = 0;
+    }
 }
 
 uint8_t dma_read_cycle() {
@@ -526,6 +904,25 @@ uint8_t dma_read_cycle() {
     return value;
 }
 
+// APA pixel mask for a DST address (BPP from VCTL)
+static uint8_t dma_apa_mask(unsigned addr) {
+    // HW uses AND-OR gates:
+    if (VidCtl & VCTL_4BPP) {
+        return 15 << ((addr&4)>>2); // position %1111 mask using bit %1xx
+    } else {
+        return 3 << ((addr&6)>>1);  // position %11 mask using bits %11x
+    }
+}
+
+// mark the 256-byte page written by a DMA cycle
+static void dirty_ram(uint16_t addr) {
+    PageDirty[RAMViewPage[addr>>14] + ((addr>>8) & 63)] = 1;
+}
+static void dirty_vram(uint16_t addr) {
+    PageDirty[PAGE_VRAM + ((addr>>8) & 63)] = 1;
+    if (LatState == LAT_SCANNED) lat_vram();
+}
+
 void dma_write_cycle() {
     switch (DMA_Ctl & DMA_Mode) {
         case DMA_Copy:
@@ -533,9 +930,11 @@ void dma_write_cycle() {
             // Write the DL value.
             if (DMA_Ctl & dma_ctl_to_vram) {
                 VRAM[DMA_Dst & 0x3FFF] = DMA_DL;
+                dirty_vram(DMA_Dst);
             } else {
-                if (RAMViewWR[DMA_Dst>>14]) {
+                if (view_writable(DMA_Dst>>14)) {
                     RAMView[DMA_Dst>>14][DMA_Dst & 0x3FFF] = DMA_DL;
+                    dirty_ram(DMA_Dst);
                 }
             }
             DMA_Dst = (DMA_Dst + DMA_dinc) & 0xFFFF;
@@ -546,9 +945,11 @@ void dma_write_cycle() {
             if (DMA_DL != 0x00) {
                 if (DMA_Ctl & dma_ctl_to_vram) {
                     VRAM[DMA_Dst & 0x3FFF] = DMA_DL;
+                    dirty_vram(DMA_Dst);
                 } else {
-                    if (RAMViewWR[DMA_Dst>>14]) {
+                    if (view_writable(DMA_Dst>>14)) {
                         RAMView[DMA_Dst>>14][DMA_Dst & 0x3FFF] = DMA_DL;
+                        dirty_ram(DMA_Dst);
                     }
                 }
             }
@@ -561,9 +962,11 @@ void dma_write_cycle() {
             uint8_t wr = (DMA_Dst&1) ? DMA_Table : DMA_DL; // 0=[FILL] 1=[TABLE]
             if (DMA_Ctl & dma_ctl_to_vram) {
                 VRAM[DMA_Dst & 0x3FFF] = wr;
+                dirty_vram(DMA_Dst);
             } else {
-                if (RAMViewWR[DMA_Dst>>14]) {
+                if (view_writable(DMA_Dst>>14)) {
                     RAMView[DMA_Dst>>14][DMA_Dst & 0x3FFF] = wr;
+                    dirty_ram(DMA_Dst);
                 }
             }
             DMA_Dst = (DMA_Dst + DMA_dinc) & 0xFFFF;
@@ -571,20 +974,17 @@ void dma_write_cycle() {
         }
         case DMA_APA: {
             // APA masked write.
-            uint8_t bit_mask; // HW uses AND-OR gates:
-            if (VidCtl & VCTL_4BPP) {
-                bit_mask = 15 << ((DMA_Dst&4)>>2); // position %1111 mask using bit %1xx
-            } else {
-                bit_mask = 3 << ((DMA_Dst&6)>>1); // position %11 mask using bits %11x
-            }
+            uint8_t bit_mask = dma_apa_mask(DMA_Dst);
             // Data Bus multiplexor, downstream of DL.
             uint8_t wr = (DMA_DL & ~bit_mask) | (DMA_Table & bit_mask); // APA mask
             if (DMA_Ctl & dma_ctl_to_vram) {
                 // VRAM address is divided by 8 (HW: select on VRAM addr bus)
                 VRAM[(DMA_Dst>>3) & 0x3FFF] = wr;
+                dirty_vram(DMA_Dst>>3);
             } else {
-                if (RAMViewWR[DMA_Dst>>14]) {
+                if (view_writable(DMA_Dst>>14)) {
                     RAMView[DMA_Dst>>14][DMA_Dst & 0x3FFF] = wr;
+                    dirty_ram(DMA_Dst);
                 }
             }
             DMA_Dst = (DMA_Dst + DMA_dinc) & 0xFFFF;
@@ -593,18 +993,22 @@ void dma_write_cycle() {
         case DMA_Palette: {
             // Write palette memory, 5-bit address
             PAL_RAM[DMA_Dst & (PAL_SIZE-1)] = DMA_DL;
+            PageDirty[PAGE_PAL] = 1;
+            vdp_palette(DMA_Dst & (PAL_SIZE-1));
             DMA_Dst = (DMA_Dst + DMA_dinc) & 0xFFFF;
             break;
         }
         case DMA_Sprite: {
             // Write sprite memory, 7-bit address
             SPR_RAM[DMA_Dst & (SPR_SIZE-1)] = DMA_DL;
+            PageDirty[PAGE_SPR] = 1;
             DMA_Dst = (DMA_Dst + DMA_dinc) & 0xFFFF;
             break;
         }
         case DMA_SprClr: {
             // Write $FF to sprite memory, 7-bit address ignoring low 2 bits.
             SPR_RAM[DMA_Dst & (SPR_SIZE-1) & 0xFC] = 0xFF;
+            PageDirty[PAGE_SPR] = 1;
             // Increment DST by 4 (HW only wired up for DST)
             // XXX does vertical mode override this? (doesn't increment low bits)
             uint16_t inc = (DMA_dinc==1 ? 4 : (DMA_dinc == 65535 ? 65532 : DMA_dinc));
@@ -615,6 +1019,192 @@ void dma_write_cycle() {
 
 }
 
+// Bulk DMA (Copy, Fill, Masked, AltFill, RAM APA): performs `count` transfers with
+// the same result as `count` read/write cycles, but without VDP catch-up.
+// Caller must ensure the VDP is not using VRAM during the transfers.
+static void dma_bulk(unsigned count) {
+    uint8_t mode = DMA_Ctl & DMA_Mode;
+    int sdir = (DMA_sinc == 1) ? 1 : -1;                                // +1 or -1
+    int dstep = (DMA_dinc < 0x8000) ? DMA_dinc : (int)DMA_dinc - 65536; // +/-1 or +/-width
+    while (count) {
+        // split into spans that stay within one 16K page (VRAM wraps at 16K)
+        int s = DMA_Src & 0x3FFF;
+        int d = DMA_Dst & 0x3FFF;
+        uint8_t wr = (DMA_Ctl & dma_ctl_to_vram) ? 1 : view_writable(DMA_Dst>>14); // before RAMView
+        uint8_t* src = (DMA_Ctl & dma_ctl_from_vram) ? VRAM : RAMView[DMA_Src>>14];
+        uint8_t* dst = (DMA_Ctl & dma_ctl_to_vram) ? VRAM : RAMView[DMA_Dst>>14];
+        int n = count;
+        int room = (dstep > 0) ? (0x3FFF-d)/dstep + 1 : d/-dstep + 1;
+        if (n > room) n = room;
+        if (mode != DMA_Fill) {                      // Fill doesn't advance SRC
+            room = (sdir > 0) ? 0x4000 - s : s + 1;
+            if (n > room) n = room;
+        }
+        // byte i moves src[s + i*sdir] to dst[d + i*dstep]
+        int s_lo = (sdir > 0) ? s : s - (n-1);
+        int d_lo = (dstep > 0) ? d : d + (n-1)*dstep;
+        int d_hi = (dstep > 0) ? d + (n-1)*dstep : d;
+        if (src == dst && mode != DMA_Fill && !(s == d && sdir == dstep) &&
+            s_lo <= d_hi && d_lo <= s_lo+n-1) {
+            // overlapping spans: byte order matters, so copy serially like HW
+            for (int i=0; i<n; i++) {
+                dma_read_cycle();
+                dma_write_cycle();
+            }
+            count -= n;
+            continue;
+        }
+        // last byte read, before any in-place write (Fill doesn't read SRC)
+        uint8_t last = (mode != DMA_Fill) ? src[s+(n-1)*sdir] : DMA_DL;
+        if (wr) {
+            switch (mode) {
+                case DMA_Copy:
+                    if (dstep == sdir) {
+                        memmove(dst+d_lo, src+s_lo, n); // may be in-place
+                    } else {
+                        for (int i=0; i<n; i++) dst[d+i*dstep] = src[s+i*sdir];
+                    }
+                    break;
+                case DMA_Fill:
+                    if (dstep == 1 || dstep == -1) {
+                        memset(dst+d_lo, DMA_DL, n);
+                    } else {
+                        for (int i=0; i<n; i++) dst[d+i*dstep] = DMA_DL;
+                    }
+                    break;
+                case DMA_Masked:
+                    if (dstep == sdir) {
+                        dma_masked(dst+d_lo, src+s_lo, n);
+                    } else {
+                        for (int i=0; i<n; i++) {
+                            uint8_t v = src[s+i*sdir];
+                            if (v) dst[d+i*dstep] = v;   // skip zero bytes
+                        }
+                    }
+                    break;
+                case DMA_AltFill:
+                case DMA_APA: {
+                    // Both merge SRC with [TABLE] under a mask that depends on the
+                    // DST address. Quirk: AltFill's even bytes come from SRC,
+                    // because the read cycle reloads DL.
+                    if (dstep == sdir) {
+                        uint8_t mask[8];
+                        for (int i=0; i<8; i++) {
+                            mask[i] = (mode == DMA_APA) ? dma_apa_mask(d_lo+i) : ((d_lo+i)&1) ? 0xFF : 0x00;
+                        }
+                        dma_merge(dst+d_lo, src+s_lo, n, DMA_Table, mask);
+                    } else {
+                        for (int i=0; i<n; i++) {
+                            int at = d+i*dstep;
+                            uint8_t m = (mode == DMA_APA) ? dma_apa_mask(at) : (at&1) ? 0xFF : 0x00;
+                            dst[at] = (src[s+i*sdir] & ~m) | (DMA_Table & m);
+                        }
+                    }
+                    break;
+                }
+            }
+            unsigned base = (DMA_Ctl & dma_ctl_to_vram) ? PAGE_VRAM : RAMViewPage[DMA_Dst>>14];
+            for (int p=d_lo>>8; p<=d_hi>>8; p++) PageDirty[base + p] = 1;
+            if (base == PAGE_VRAM && LatState == LAT_SCANNED) lat_vram();
+        }
+        if (mode != DMA_Fill) {
+            DMA_DL = last;                           // latched by the last read cycle
+            DMA_Src = (DMA_Src + n*DMA_sinc) & 0xFFFF;
+        }
+        DMA_Dst = (DMA_Dst + n*DMA_dinc) & 0xFFFF;
+        count -= n;
+    }
+}
+
+// IO_DRUN for Copy, Fill, Masked, AltFill and RAM APA: transfers that cannot be stalled
+// by the VRAM interlock are done in bulk and their cycles charged in one step.
+static void dma_run() {
+    unsigned count = DMA_Run ? DMA_Run : 256;   // 0=256
+    BusStats.dma_bytes[DMA_Ctl & DMA_Mode] += count;
+    while (count) {
+        unsigned n = count;
+        if (DMA_Ctl & (dma_ctl_to_vram|dma_ctl_from_vram)) {
+            // one transfer every 2 CPU cycles (9 VDP clocks); count the ones
+            // that start before VBusy rises.
+            uint64_t now = ((uint64_t)clockticks6502 * 9) / 2;
+            uint64_t slots = vdp_vbusy ? 0 : (vdp_vbusy_edge() - now + 8) / 9;
+            if (slots == 0) {
+                // VRAM is busy: stall on the interlock, then one transfer.
+                dma_interlock();
+                dma_read_cycle();
+                clockticks6502++;            // +1 RAM cycle (one CPU cycle)
+                dma_write_cycle();
+                clockticks6502++;            // +1 RAM cycle (one CPU cycle)
+                advance_vdp();
+                count--;
+                continue;
+            }
+            if (n > slots) n = slots;
+        }
+        dma_bulk(n);
+        clockticks6502 += 2*n;               // +2 RAM cycles per transfer
+        advance_vdp();
+        count -= n;
+    }
+    DMA_Run = 0;
+}
+
+// Disk interface: `n` bytes from the host as DMA write cycles to DMA_Dst.
+// Forward copies to RAM move whole spans; other modes go cycle by cycle.
+void dma_from_host(const uint8_t* buf, unsigned n) {
+    BusStats.dma_bytes[DMA_Ctl & DMA_Mode] += n;
+    if ((DMA_Ctl & (DMA_Mode|dma_ctl_to_vram|dma_ctl_vertical|dma_ctl_reverse)) == DMA_Copy) {
+        while (n) {
+            unsigned d = DMA_Dst & 0x3FFF, span = 0x4000 - d;
+            if (span > n) span = n;
+            if (view_writable(DMA_Dst>>14)) {       // before RAMView
+                memcpy(RAMView[DMA_Dst>>14] + d, buf, span);
+                for (unsigned p=d>>8; p<=(d+span-1)>>8; p++) PageDirty[RAMViewPage[DMA_Dst>>14] + p] = 1;
+            }
+            DMA_DL = buf[span-1];
+            DMA_Dst = (DMA_Dst + span) & 0xFFFF;
+            clockticks6502 += span;                 // +1 RAM cycle per byte
+            buf += span;
+            n -= span;
+        }
+        advance_vdp();
+        return;
+    }
+    for (unsigned i=0; i<n; i++) {
+        dma_interlock();
+        DMA_DL = buf[i];
+        dma_write_cycle();
+        clockticks6502++;                           // +1 RAM cycle (one CPU cycle)
+        if (DMA_Ctl & dma_ctl_to_vram) advance_vdp();
+    }
+    advance_vdp();
+}
+
+// Disk interface: `n` bytes to the host as DMA read cycles from DMA_Src.
+void dma_to_host(uint8_t* buf, unsigned n) {
+    BusStats.dma_bytes[DMA_Ctl & DMA_Mode] += n;
+    if ((DMA_Ctl & (DMA_Mode|dma_ctl_from_vram|dma_ctl_reverse)) == DMA_Copy) {
+        while (n) {
+            unsigned s = DMA_Src & 0x3FFF, span = 0x4000 - s;
+            if (span > n) span = n;
+            memcpy(buf, RAMView[DMA_Src>>14] + s, span);
+            DMA_DL = buf[span-1];
+            DMA_Src = (DMA_Src + span) & 0xFFFF;
+            clockticks6502 += span;                 // +1 RAM cycle per byte
+            buf += span;
+            n -= span;
+        }
+        advance_vdp();
+        return;
+    }
+    for (unsigned i=0; i<n; i++) {
+        dma_interlock();
+        buf[i] = dma_read_cycle();
+        clockticks6502++;                           // +1 RAM cycle (one CPU cycle)
+    }
+    advance_vdp();
+}
+
 uint8_t read6502(uint16_t address) {
     // address < 0xC0 or address >= 0x100
     if ((unsigned)address - 0xC0 >= 0x40) {
@@ -628,8 +1218,9 @@ void write6502(uint16_t address, uint8_t value) {
     // address < 0xC0 or address >= 0x100
     if ((unsigned)address - 0xC0 >= 0x40) {
         unsigned page = address >> 14;
-        if (RAMViewWR[page]) {
+        if (RAMViewWR[page] && view_writable(page)) {
             RAMView[page][address & 0x3fff] = value; // banked RAM/ROM
+            PageDirty[RAMViewPage[page] + ((address >> 8) & 63)] = 1;
         }
     } else {
         ula_io_write(address, value);
@@ -0,0 +1,483 @@
+// Robo Emulator - BASIC Program Injection
+
+// A host copy of the ROM tokenizer (`tokenize` in rom6K.asm) and its keyword
+// tables, so a BASIC text file can be loaded straight into RAM instead of being
+// typed through the keyboard matrix. The program image starts at BasePg:
+//   $E9, then per line: OP_LN, LineLo, LineHi, Len (with header), PrevLen, tokens
+//   ending with an OP_LN line numbered $FFFF; TopPtr points after it.
+// Verify mode also runs each line through the ROM's own `tokenize` on the CPU
+// and reports the lines where the two disagree.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "header.h"
+
+enum basic_mem {
+    BAS_MARKER     = 0xE9,    // first byte of a program
+    BAS_HEADER     = 5,       // OP_LN, LineLo, LineHi, Len, PrevLen
+    BAS_MAXTOK     = 127,     // EmitOfs overflows at 128
+    BAS_MAXLINE    = 128,     // LineBuf size with the terminator
+};
+
+enum basic_op {
+    OP_LN          = 0xC0,
+    OP_DATA        = 0xC3,
+    OP_ELSE        = 0xC6,
+    OP_LET         = 0xCD,
+    OP_REM         = 0xDC,
+    OP_ELSEA       = 0x86,
+    OP_THEN        = 0xA5,
+    OP_FNRET       = 0xA6,
+    OP_I0          = 0xF0,
+    OP_INT2        = 0xFA,
+    OP_INT3        = 0xFB,
+    OP_INT4        = 0xFC,
+};
+
+typedef struct basic_kw {
+    const char* name;
+    uint8_t hi;               // token; bit 6 set: more keywords follow
+} basic_kw;
+
+// stmt_page: statements get $C0 set when emitted
+static const basic_kw StmtKws[] = {
+    { "CLS", 0xC1 }, { "CLOSE", 0x82 },
+    { "DATA", 0xC3 }, { "DIM", 0xC4 }, { "DEF", 0x85 },
+    { "ELSE", 0xC6 }, { "END", 0x87 },
+    { "FOR", 0x88 },
+    { "GOTO", 0xC9 }, { "GOSUB", 0x8A },
+    { "IF", 0xCB }, { "INPUT", 0x8C },
+    { "LET", 0xCD }, { "LINE", 0xCE }, { "LOAD", 0x8F },
+    { "MODE", 0x90 },
+    { "NEXT", 0x91 },
+    { "OPT", 0xD2 }, { "OPEN", 0x93 },
+    { "PUT", 0xD4 }, { "PRINT", 0xD5 }, { "PLOT", 0xD6 }, { "POKE", 0x97 },
+    { "READ", 0xD8 }, { "REPEAT", 0xD9 }, { "RESTORE", 0xDA }, { "RETURN", 0xDB }, { "REM", 0x9C },
+    { "SOUND", 0x9D },
+    { "UNTIL", 0x9E },
+    { "WAIT", 0x9F },
+};
+// first keyword for '@', A-Z
+static const uint8_t StmtIdx[27] = {
+    0, 0, 0, 0, 2, 5, 7, 8, 10, 10, 12, 12, 12, 15, 16, 17, 19, 23, 23, 28, 29, 29, 30, 30, 30, 30, 30,
+};
+
+// expr_page: bit 6 is cleared when emitted
+static const basic_kw ExprKws[] = {
+    { "ABS", 0xC0 }, { "ASC", 0xC1 }, { "AND", 0x9D },
+    { "BTN", 0x82 },
+    { "CHR$", 0x83 },
+    { "DIV", 0x9E },
+    { "EOF", 0xC4 }, { "EOR", 0xDF }, { "ELSE", 0x86 },
+    { "FN", 0x85 },
+    { "GET", 0x87 },
+    { "INSTR$", 0xC8 }, { "INT", 0x89 },
+    { "JOY", 0x8A },
+    { "KEY", 0x8B },
+    { "LEN", 0xCC }, { "LEFT$", 0x8D },
+    { "MID$", 0xCE }, { "MOD", 0xA0 },
+    { "NOT", 0xA1 },
+    { "OR", 0xE2 },
+    { "POS", 0xCF }, { "PI", 0x90 },
+    { "RIGHT$", 0xD1 }, { "RND", 0x92 },
+    { "SCN", 0xD3 }, { "STRING$", 0xD4 }, { "STR$", 0xD5 }, { "SQR", 0xD6 }, { "SGN", 0xD7 }, { "STEP", 0xA3 },
+    { "TIME", 0xD8 }, { "TO", 0xE4 }, { "THEN", 0xE5 }, { "TOP", 0x99 },
+    { "USR", 0x9A },
+    { "VAL", 0xDB }, { "VPOS", 0x9C },
+};
+static const uint8_t ExprIdx[27] = {
+    0, 0, 3, 4, 5, 6, 9, 10, 11, 11, 13, 14, 15, 17, 19, 20, 21, 23, 23, 25, 31, 35, 36, 36, 36, 36, 36,
+};
+
+typedef struct basic_tok {
+    const char* in;
+    int y;                    // input offset
+    uint8_t* out;
+    int len;                  // EmitOfs
+    uint8_t let;              // D: implied LET after `:`
+    const char* err;
+} basic_tok;
+
+// is_alpha: '@', A-Z and a-z -> 0-26, else -1
+static int bas_alpha(uint8_t c) {
+    uint8_t i = (uint8_t)((c & 0xDF) - 64);
+    return i < 27 ? i : -1;
+}
+
+static int bas_digit(uint8_t c) {
+    return (uint8_t)(c - '0') < 10;
+}
+
+static void bas_skip(basic_tok* t) {
+    while (t->in[t->y] == ' ') t->y++;
+}
+
+static void bas_emit(basic_tok* t, uint8_t b) {
+    if (t->len >= BAS_MAXTOK) {
+        if (!t->err) t->err = "Too big";
+        return;
+    }
+    t->out[t->len++] = b;
+}
+
+// match_kws: the first keyword that the input starts with, trying keywords
+// from `first` while bit 6 of their token is set. Returns the token or 0.
+static uint8_t bas_match(basic_tok* t, const basic_kw* kws, unsigned first) {
+    for (unsigned k=first; ; k++) {
+        const char* name = kws[k].name;
+        int n = 0;
+        while (name[n] && name[n] == t->in[t->y + n]) n++;
+        if (!name[n]) {
+            t->y += n;
+            return kws[k].hi;
+        }
+        if (!(kws[k].hi & 0x40)) return 0;
+    }
+}
+
+// num_u24 and the smallest encoding of the value
+static void bas_num(basic_tok* t) {
+    uint32_t v = 0;
+    while (bas_digit(t->in[t->y])) {
+        v = v*10 + (t->in[t->y++] - '0');
+        if (v >= 1u<<24) {
+            t->err = "Too big";
+            return;
+        }
+    }
+    if (v >= 0x10000) {
+        bas_emit(t, OP_INT4);
+        bas_emit(t, v >> 16);
+        bas_emit(t, v >> 8);
+    } else if (v >= 0x100) {
+        bas_emit(t, OP_INT3);
+        bas_emit(t, v >> 8);
+    } else if (v >= 10) {
+        bas_emit(t, OP_INT2);
+    } else {
+        v |= OP_I0;
+    }
+    bas_emit(t, v);
+}
+
+// emit_var_ex: VAR[$]
+static void bas_var(basic_tok* t) {
+    while (bas_alpha(t->in[t->y]) >= 0 || bas_digit(t->in[t->y])) bas_emit(t, t->in[t->y++]);
+    if (t->in[t->y] == '$') bas_emit(t, t->in[t->y++]);
+}
+
+// emit_str: the opening quote has not been consumed
+static void bas_str(basic_tok* t) {
+    bas_emit(t, '"');
+    t->y++;
+    for (;;) {
+        uint8_t c = t->in[t->y];
+        if (!c) {
+            t->err = "Missing \"";
+            return;
+        }
+        t->y++;
+        if (c == '"' && t->in[t->y] != '"') break;
+        if (c == '"') t->y++;       // "" is one quote
+        bas_emit(t, c);
+    }
+    bas_emit(t, '"');
+}
+
+// statement position: a keyword, FN return, or implied LET
+static int bas_stmt(basic_tok* t) {
+    bas_skip(t);
+    uint8_t c = t->in[t->y];
+    int az = bas_alpha(c);
+    if (az < 0) {
+        if (c != '=') {
+            t->err = "Problem";
+            return 0;
+        }
+        bas_emit(t, OP_FNRET);
+        t->y++;
+        return 1;
+    }
+    uint8_t op = bas_match(t, StmtKws, StmtIdx[az]);
+    if (!op) {
+        if (t->let & 0x80) bas_emit(t, OP_LET);
+        bas_var(t);
+        bas_skip(t);
+        if (t->in[t->y] != '=') t->err = "Problem";
+        return 1;
+    }
+    op |= 0xC0;
+    bas_emit(t, op);
+    if (op == OP_DATA || op == OP_REM) {
+        bas_skip(t);
+        while (t->in[t->y]) bas_emit(t, t->in[t->y++]);
+    } else if (op == OP_ELSE) {
+        bas_skip(t);
+        if (bas_digit(t->in[t->y])) bas_num(t);
+        else return bas_stmt(t);
+    }
+    return 1;
+}
+
+// tokenize `line` into `out` (at least BAS_MAXTOK bytes); returns the length,
+// or -1 with `*err` set to the ROM's message.
+int basic_tokenize(const char* line, uint8_t* out, const char** err) {
+    basic_tok t = { line, 0, out, 0, 0, 0 };
+    bas_stmt(&t);
+    while (!t.err) {
+        bas_skip(&t);
+        uint8_t c = t.in[t.y];
+        if (!c) break;
+        int az = bas_alpha(c);
+        if (az >= 0) {
+            uint8_t op = bas_match(&t, ExprKws, ExprIdx[az]);
+            if (!op) {
+                bas_var(&t);
+                continue;
+            }
+            op &= 0xBF;
+            if (op != OP_THEN && op != OP_ELSEA) {
+                bas_emit(&t, op);
+                continue;
+            }
+            if (op == OP_ELSEA) bas_emit(&t, OP_ELSE);
+            bas_skip(&t);
+            if (bas_digit(t.in[t.y])) bas_num(&t);
+            else bas_stmt(&t);
+        } else if (c == '"') {
+            bas_str(&t);
+        } else if (bas_digit(c)) {
+            bas_num(&t);
+        } else if (c == ':') {
+            t.y++;
+            t.let = 0x80;
+            bas_stmt(&t);
+        } else if (c == '<' || c == '>') {
+            // 24:<< 25:<= 26:<> 28:>< 29:>= 30:>>
+            uint8_t n = (uint8_t)(t.in[t.y+1] - '<');
+            t.y++;
+            if (n < 3) {
+                bas_emit(&t, ((c << 1) & 0x1F) | n);
+                t.y++;
+            } else {
+                bas_emit(&t, c);
+            }
+        } else {
+            bas_emit(&t, c);
+            t.y++;
+        }
+    }
+    if (t.err) {
+        *err = t.err;
+        return -1;
+    }
+    return t.len;
+}
+
+// Verify: run the ROM's tokenize on the CPU with the line in LineBuf.
+// The entry is found by its first bytes: LDA #0, STA D, JSR, JSR, BCS.
+static uint16_t bas_rom_entry() {
+    for (unsigned i=0; i+11 <= 0x1000; i++) {
+        const uint8_t* p = SysROM + i;
+        if (p[0] == 0xA9 && p[1] == 0x00 && p[2] == 0x85 && p[3] == 0xC8 &&
+            p[4] == 0x20 && p[7] == 0x20 && p[10] == 0xB0) return 0xC000 + i;
+    }
+    return 0;
+}
+
+// The ROM's error exits, found by their first bytes (all end up in repl):
+//   repl:       JSR readline, JSR newline, LDY #0, STY EmitOfs, STY EmitPtch
+//   report_err: JSR printmsgln (the JSR just before repl), JMP repl
+//   err_expect: PHA, LDY #msg, JSR printmsg, PLA, JSR wrchr, JSR newline, JMP repl
+static void bas_rom_errors(uint16_t* stop) {
+    stop[0] = stop[1] = stop[2] = 0;
+    for (unsigned i=3; i+12 <= 0x1000; i++) {
+        const uint8_t* p = SysROM + i;
+        if (p[0] == 0x20 && p[3] == 0x20 && p[6] == 0xA0 && p[7] == 0x00 &&
+            p[8] == 0x84 && p[9] == ZP_EMITOFS && p[10] == 0x84 && p[11] == ZP_EMITPTCH) {
+            stop[0] = 0xC000 + i;
+            break;
+        }
+    }
+    if (!stop[0]) return;
+    unsigned at = stop[0] - 0xC000;
+    uint8_t rl = stop[0] & 0xFF, rh = stop[0] >> 8;
+    uint8_t ml = SysROM[at-2], mh = SysROM[at-1];   // printmsgln
+    for (unsigned i=0; i+16 <= 0x1000; i++) {
+        const uint8_t* p = SysROM + i;
+        if (p[0] == 0x20 && p[1] == ml && p[2] == mh && p[3] == 0x4C && p[4] == rl && p[5] == rh) {
+            stop[1] = 0xC000 + i;
+        }
+        if (p[0] == 0x48 && p[1] == 0xA0 && p[3] == 0x20 && p[6] == 0x68 && p[7] == 0x20 &&
+            p[10] == 0x20 && p[13] == 0x4C && p[14] == rl && p[15] == rh) {
+            stop[2] = 0xC000 + i;
+        }
+    }
+}
+
+static int bas_rom_tokenize(uint16_t entry, const uint16_t* stop, const char* text, int ofs, uint8_t* out) {
+    static uint8_t ram[sizeof(MainRAM)], cart[sizeof(CartRAM)];
+    uint16_t pc0 = pc;
+    uint8_t sp0 = sp, a0 = a, x0 = x, y0 = y, status0 = status, irq0 = pend_irq;
+    uint32_t clk0 = clockticks6502, goal0 = clockgoal6502, ins0 = instructions;
+    memcpy(ram, MainRAM, sizeof(ram));
+    memcpy(cart, CartRAM, sizeof(cart));
+    ula_sandbox(1);                         // no IO or expansion writes: the VDP stays put
+
+    memcpy(MainRAM + BAS_LINEBUF, text, strlen(text)+1);
+    MainRAM[ZP_EMITOFS] = 0;
+    MainRAM[ZP_EMITPTCH] = 0;
+    MainRAM[ZP_PTR] = BAS_LINEBUF & 0xFF;   // num_u24 reads (Ptr),Y
+    MainRAM[ZP_PTR+1] = BAS_LINEBUF >> 8;
+    MainRAM[0x1FF] = 0xFF;                  // RTS to $FFFF
+    MainRAM[0x1FE] = 0xFE;
+    sp = 0xFD;
+    pc = entry;
+    y = (uint8_t)ofs;
+    status |= 0x04;                         // no IRQ
+    pend_irq = 0;
+    while (pc != 0xFFFF && clockticks6502 - clk0 < 1000000) {
+        if (pc && (pc == stop[0] || pc == stop[1] || pc == stop[2])) break;   // error
+        step6502();
+    }
+    int len = (pc == 0xFFFF) ? MainRAM[ZP_EMITOFS] : -1;
+    if (len > BAS_MAXTOK) len = -1;
+    if (len > 0) memcpy(out, MainRAM + BAS_LINEBUF, len);
+
+    ula_sandbox(0);
+    memcpy(MainRAM, ram, sizeof(ram));
+    memcpy(CartRAM, cart, sizeof(cart));
+    pc = pc0; sp = sp0; a = a0; x = x0; y = y0; status = status0; pend_irq = irq0;
+    clockticks6502 = clk0; clockgoal6502 = goal0; instructions = ins0;
+    return len;
+}
+
+typedef struct basic_line {
+    uint16_t num;
+    uint8_t len;
+    uint32_t order;           // later lines replace earlier ones
+    uint8_t tok[BAS_MAXTOK];
+} basic_line;
+
+static int bas_line_cmp(const void* a, const void* b) {
+    const basic_line* x = a;
+    const basic_line* y = b;
+    if (x->num != y->num) return x->num < y->num ? -1 : 1;
+    return x->order < y->order ? -1 : 1;
+}
+
+// Load a BASIC text file into RAM as a ready-to-run program (after the ROM has
+// set VidBase). Returns the number of lines, or -1.
+int basic_load(const char* path, int verify) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        printf("cannot open %s\n", path);
+        return -1;
+    }
+    basic_line* lines = 0;
+    uint32_t count = 0, cap = 0, bad = 0, mismatch = 0, n = 0;
+    uint16_t entry = verify ? bas_rom_entry() : 0;
+    uint16_t stop[3];
+    if (verify && !entry) printf("basic: cannot find tokenize in the ROM\n");
+    if (entry) bas_rom_errors(stop);
+    char text[512];
+    while (fgets(text, sizeof(text), f)) {
+        n++;
+        size_t end = strcspn(text, "\r\n");
+        text[end] = 0;
+        int ofs = 0;
+        while (text[ofs] == ' ') ofs++;
+        if (!text[ofs]) continue;
+        if (end >= BAS_MAXLINE || !bas_digit(text[ofs])) {
+            printf("%s:%u: %s\n", path, n, end >= BAS_MAXLINE ? "line too long" : "no line number");
+            bad++;
+            continue;
+        }
+        uint32_t num = 0;
+        while (bas_digit(text[ofs]) && num < 0x10000) num = num*10 + (text[ofs++] - '0');
+        if (num >= 0xFFFF) {
+            printf("%s:%u: Range?\n", path, n);
+            bad++;
+            continue;
+        }
+        if (count == cap) {
+            cap = cap ? cap*2 : 256;
+            basic_line* more = realloc(lines, cap * sizeof(basic_line));
+            if (!more) break;
+            lines = more;
+        }
+        basic_line* ln = &lines[count];
+        const char* err = 0;
+        int len = 0;
+        int body = ofs;
+        while (text[body] == ' ') body++;
+        if (text[body]) len = basic_tokenize(text + ofs, ln->tok, &err);
+        if (len < 0) {
+            printf("%s:%u: %s\n", path, n, err);
+            bad++;
+            continue;
+        }
+        if (entry && text[body]) {
+            uint8_t rom[BAS_MAXTOK];
+            int rlen = bas_rom_tokenize(entry, stop, text, ofs, rom);
+            if (rlen != len || memcmp(rom, ln->tok, len)) {
+                printf("%s:%u: ROM tokenizer differs (%d bytes, host %d):", path, n, rlen, len);
+                for (int i=0; i<rlen; i++) printf(" %02X", rom[i]);
+                printf(" /");
+                for (int i=0; i<len; i++) printf(" %02X", ln->tok[i]);
+                printf("\n");
+                mismatch++;
+            }
+        }
+        ln->num = (uint16_t)num;
+        ln->len = (uint8_t)len;       // empty: deletes the line
+        ln->order = count++;
+    }
+    fclose(f);
+    qsort(lines, count, sizeof(basic_line), bas_line_cmp);
+
+    // build the image below video memory
+    uint8_t vidbase = MainRAM[ZP_VIDBASE];
+    uint32_t limit = (vidbase && vidbase*256u <= sizeof(MainRAM)) ? vidbase*256u : sizeof(MainRAM);
+    uint32_t at = BAS_BASE, kept = 0;
+    uint8_t prev = 0;
+    MainRAM[at++] = BAS_MARKER;
+    for (uint32_t i=0; i<count; i++) {
+        basic_line* ln = &lines[i];
+        if (i+1 < count && lines[i+1].num == ln->num) continue;
+        if (!ln->len) continue;
+        uint32_t size = BAS_HEADER + ln->len;
+        if (at + size + BAS_HEADER > limit) {
+            printf("basic: %s does not fit below $%04X\n", path, limit);
+            free(lines);
+            return -1;
+        }
+        uint8_t hdr[BAS_HEADER] = { OP_LN, ln->num & 0xFF, ln->num >> 8, (uint8_t)size, prev };
+        memcpy(MainRAM + at, hdr, BAS_HEADER);
+        memcpy(MainRAM + at + BAS_HEADER, ln->tok, ln->len);
+        at += size;
+        prev = (uint8_t)size;
+        kept++;
+    }
+    uint8_t end[BAS_HEADER] = { OP_LN, 0xFF, 0xFF, BAS_HEADER, prev };
+    memcpy(MainRAM + at, end, BAS_HEADER);
+    at += BAS_HEADER;
+    free(lines);
+
+    // TopPtr, then what set_prog and CLEAR reset
+    MainRAM[ZP_TOPPTR] = at & 0xFF;
+    MainRAM[ZP_TOPPTR+1] = at >> 8;
+    MainRAM[ZP_FREEPTR] = at & 0xFF;
+    MainRAM[ZP_FREEPTR+1] = at >> 8;
+    MainRAM[ZP_HEAPPTR] = 0;
+    MainRAM[ZP_HEAPPTR+1] = limit >> 8;
+    memset(MainRAM + ZP_VARPTRS, 0, 52);
+    MainRAM[ZP_CODE] = 0;
+    MainRAM[ZP_CODE+1] = BAS_BASE >> 8;
+    MainRAM[ZP_DATA] = 0;
+    MainRAM[ZP_DATA+1] = 0;
+    MainRAM[ZP_OPTOP] = 0;
+    if (verify) printf("basic: %u lines checked against the ROM, %u differ\n", count, mismatch);
+    return bad ? -1 : (int)kept;
+}
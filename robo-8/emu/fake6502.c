@@ -192,6 +192,8 @@ uint16_t dbg_break = 0;
 //externally supplied functions
 extern uint8_t read6502(uint16_t address);
 extern void write6502(uint16_t address, uint8_t value);
+extern uint8_t HleMap[8192];
+extern int hle_trap();
 
 //a few general functions used by various other functions
 void push16(uint16_t pushval) {
@@ -968,6 +970,8 @@ void exec6502(uint32_t tickcount) {
             }
         }
 
+        if (((HleMap[pc >> 3] >> (pc & 7)) & 1) && hle_trap()) continue;
+
         opcode = read6502(pc++);
         if (opcode == 0x60) {
             int x=1; (void)x; // breakpoint
@@ -20,13 +20,47 @@ extern uint8_t CartRAM[8*1024];
 extern uint8_t CharROM[256*8];
 extern uint8_t* MemMap[8];
 
+// rom6K.asm RAM layout (zero page and BASIC buffers)
+enum rom_mem {
+    BAS_LINEBUF    = 0x0100,  // LineBuf / EmitBuf
+    BAS_BASE       = 0x0200,  // BasePg
+    ZP_VARPTRS     = 0x40,    // 26 x variable pointers
+    ZP_OPTOP       = 0x74,
+    ZP_TOPPTR      = 0x76,
+    ZP_FREEPTR     = 0x78,
+    ZP_HEAPPTR     = 0x7A,
+    ZP_CODE        = 0x7C,
+    ZP_DATA        = 0x7E,
+    ZP_EMITOFS     = 0x7E,    // aliases Data
+    ZP_EMITPTCH    = 0x7F,    // aliases DataH
+    ZP_SRC         = 0xC0,
+    ZP_SRCH        = 0xC1,
+    ZP_DST         = 0xC2,
+    ZP_DSTH        = 0xC3,
+    ZP_PTR         = 0xC4,
+    ZP_PTRH        = 0xC5,
+    ZP_B           = 0xC6,
+    ZP_C           = 0xC7,
+    ZP_D           = 0xC8,
+    ZP_F           = 0xCA,
+    ZP_ACCE        = 0xCC,
+    ZP_ACC2        = 0xCD,
+    ZP_ACC1        = 0xCE,
+    ZP_ACC0        = 0xCF,
+    ZP_TERM2       = 0xC1,    // aliases SrcH
+    ZP_TERM1       = 0xC2,    // aliases Dst
+    ZP_TERM0       = 0xC3,    // aliases DstH
+    ZP_TXTP        = 0xD8,
+    ZP_VIDBASE     = 0xDD,
+};
+
 // Fake6502
 void reset6502();
 void exec6502(uint32_t tickcount);
 void step6502();
 void request_irq();
 void request_nmi();
-extern uint32_t clockticks6502;
+extern uint32_t clockticks6502, clockgoal6502, instructions;
 extern uint16_t pc;
 extern uint8_t sp, a, x, y, status;
 extern uint8_t dbg_enable;
@@ -40,6 +74,8 @@ void dbg_decode_next_op(uint16_t pc);
 // ULA
 uint8_t read6502(uint16_t address);
 void write6502(uint16_t address, uint8_t value);
+void ula_map_slot(unsigned slot, uint8_t* mem, uint8_t writable);
+void ula_sandbox(int on);
 extern uint8_t VidCtl;
 extern uint8_t VidPgC;
 extern uint8_t VidPal1;
@@ -47,16 +83,94 @@ extern uint8_t VidPal2;
 extern uint8_t KbdCol;
 extern uint8_t PSGVol;
 extern uint8_t PSGFrq;
+extern uint32_t KbdReads;
 
 // render
 int init_render();
 void final_render();
 void render();
 void advance_vdp();
+uint16_t vdp_hpos();
 extern uint16_t vdp_vcount; // 9-bit vertical line count
 extern uint8_t vdp_vblank;  // 1-bit latch
 extern uint8_t vdp_vbusy; // 1-bit latch (VDP is using VRAM)
 
+// IO event log
+enum iolog_dir {
+    IOLOG_RD       = 0,
+    IOLOG_WR       = 1,
+};
+enum iolog_fmt {
+    IOLOG_VERSION  = 1,
+    IOLOG_MACHINE  = 8,     // Robo-8 (robo-8/emu/)
+};
+typedef struct io_event {     // 16 bytes
+    uint32_t cycle;           // clockticks6502
+    uint16_t pc;              // PC after the operand fetch
+    uint16_t vcount;          // vdp_vcount
+    uint16_t hpos;            // vdp_hpos(): vdp_hcount (pixel within the line)
+    uint8_t port;             // IO address (low byte)
+    uint8_t value;
+    uint8_t dir;              // enum iolog_dir
+    uint8_t pad;
+} io_event;
+typedef struct iolog_header { // 16 bytes, followed by `count` io_event
+    char magic[6];            // "IOLOG"
+    uint8_t version;
+    uint8_t machine;
+    uint32_t count;
+    uint32_t lost;            // older events overwritten in the ring
+} iolog_header;
+extern uint64_t IoLogMask;
+void iolog_event(uint8_t port, uint8_t value, uint8_t dir);
+uint64_t iolog_ports(const char* spec);
+int iolog_dump(const char* path);
+
+// BASIC program injection
+int basic_tokenize(const char* line, uint8_t* out, const char** err);
+int basic_load(const char* path, int verify);  // lines loaded, or -1
+
+// Tape port
+enum tape_mode {
+    TAPE_STOP      = 0,
+    TAPE_PLAY      = 1,
+    TAPE_REC       = 2,
+};
+extern uint16_t TapeTrap[2];          // ROM LOAD, SAVE entry points
+int tape_open(const char* path, int fast);
+int tape_close();                     // writes the tape back if recorded on
+uint8_t tape_in();                    // IO_DATA read: bit 0
+void tape_out(uint8_t level);         // IO_DATA write: bit 0
+void tape_mode(uint8_t mode);
+uint8_t tape_state();
+void tape_rewind();
+
+// Serial port
+extern uint16_t SerTrap[2];           // byte-level PUT, GET entry points
+int serial_open(uint32_t baud);       // creates a PTY
+void serial_close();
+void serial_poll();                   // main loop
+uint8_t serial_in();                  // IO_DATA read: bits 2-1
+void serial_out(uint8_t value);       // IO_DATA write: bits 2-1
+
+// High-level emulation
+enum hle_mode {
+    HLE_OFF        = 0,       // ROM routines run on the CPU
+    HLE_ON         = 1,       // native, charging the routine's cycles
+    HLE_FAST       = 2,       // native, charging only the RTS
+    HLE_CHECK      = 3,       // native and emulated, compared
+};
+enum hle_flags {
+    HLE_ROM        = 0x01,    // ROM routine: follows HleMode (others are always on)
+};
+typedef int (*hle_fn)();      // cycles taken (RTS excluded), or -1 to run the 6502 code
+extern uint8_t HleMap[8192];  // one bit per address with a handler
+extern uint8_t HleMode;
+int hle_add(uint16_t addr, const char* name, hle_fn fn, uint8_t flags);
+void hle_init();              // finds the ROM routines (after the ROM is loaded)
+int hle_trap();               // CPU at an address in HleMap
+void hle_report();
+
 // SDL
 uint8_t scanKeyCol(uint8_t);
 
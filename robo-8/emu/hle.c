@@ -0,0 +1,560 @@
+// Robo Emulator - High-Level Emulation
+
+// Native handlers for hot ROM routines, and the traps used by the tape and serial
+// ports. HleMap has one bit per address with a handler; the CPU loop calls hle_trap()
+// there. A handler does the routine's work on the machine state (registers, flags,
+// memory) exactly as the 6502 code would, and returns the cycles the routine body
+// takes, or -1 to decline (an error path, or a case it does not cover) so the CPU
+// runs the ROM code instead. hle_trap() then returns as RTS would.
+//
+// ROM routines are found by signature (zero-page operands are part of it) and follow
+// -hle MODE:
+//   on     charge the cycles the routine would have taken
+//   fast   charge only the RTS
+//   check  run the handler, then the ROM code from the same state, and compare
+//          registers, flags, RAM and cycles (the emulated result is kept)
+// Cycle counts follow the code path taken, assuming branches stay within a page.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "header.h"
+
+enum hle_const {
+    HLE_MAX        = 32,
+    HLE_CHECK_MAX  = 1000000, // cycles before a checked routine is abandoned
+    HLE_RTS        = 6,
+};
+
+enum hle_status {
+    ST_C           = 0x01,
+    ST_Z           = 0x02,
+    ST_D           = 0x08,
+    ST_V           = 0x40,
+    ST_N           = 0x80,
+};
+
+typedef struct hle_entry {
+    uint16_t addr;
+    uint8_t flags;            // enum hle_flags
+    const char* name;
+    hle_fn fn;
+    uint32_t calls, declined, mismatches;
+    uint64_t charged;         // cycles charged (including the RTS)
+    uint64_t measured;        // check: cycles the ROM code took
+} hle_entry;
+
+typedef struct hle_sig {
+    const char* name;
+    const char* bytes;        // hex, "xx" for any byte (absolute addresses)
+    int entry;                // entry point relative to the match
+    hle_fn fn;
+} hle_sig;
+
+uint8_t HleMap[8192];
+uint8_t HleMode = HLE_OFF;
+static hle_entry HleTab[HLE_MAX];
+static unsigned HleCount = 0;
+
+// ---- machine state ----
+
+static uint8_t zp(uint8_t addr) { return MainRAM[addr]; }
+static void zp_set(uint8_t addr, uint8_t v) { MainRAM[addr] = v; }
+static uint16_t zp16(uint8_t addr) { return MainRAM[addr] | MainRAM[(uint8_t)(addr + 1)] << 8; }
+static uint32_t zp24(uint8_t lo, uint8_t mid, uint8_t hi) { return zp(lo) | zp(mid) << 8 | (uint32_t)zp(hi) << 16; }
+static void zp24_set(uint8_t lo, uint8_t mid, uint8_t hi, uint32_t v) {
+    zp_set(lo, v & 0xFF);
+    zp_set(mid, (v >> 8) & 0xFF);
+    zp_set(hi, (v >> 16) & 0xFF);
+}
+
+static uint8_t nz(uint8_t st, uint8_t v) {
+    return (st & ~(ST_N|ST_Z)) | (v & 0x80) | (v ? 0 : ST_Z);
+}
+
+// ADC (binary mode): returns the sum, updates C and V in *st
+static uint8_t adc(uint8_t* st, uint8_t x, uint8_t m) {
+    unsigned sum = x + m + (*st & ST_C);
+    uint8_t r = (uint8_t)sum;
+    *st = (*st & ~(ST_C|ST_V)) | (sum > 0xFF ? ST_C : 0) | (((x ^ r) & (m ^ r) & 0x80) ? ST_V : 0);
+    return r;
+}
+
+static uint8_t sbc(uint8_t* st, uint8_t x, uint8_t m) {
+    return adc(st, x, (uint8_t)~m);
+}
+
+// (zp),Y read penalty
+static int cross(uint16_t base, uint8_t ofs) {
+    return ((base & 0xFF) + ofs) > 0xFF;
+}
+
+// ---- ROM routines ----
+
+// div_u8: Acc=dividend, A=divisor -> Acc=quotient, A=remainder (X=0)
+static int div_u8_loop(uint8_t divisor, int cycles) {
+    uint32_t acc = zp24(ZP_ACC0, ZP_ACC1, ZP_ACC2);
+    uint8_t st = status, r = 0;
+    for (int i=0; i<24; i++) {
+        r = (uint8_t)(r << 1 | (acc >> 23));  // ROL A (the carry out is lost)
+        acc = (acc << 1) & 0xFFFFFF;
+        cycles += 5+5+5+2+3+2;                // ASL ROL ROL ROL CMP BCC
+        if (r >= divisor) {
+            st |= ST_C;
+            r = sbc(&st, r, divisor);
+            acc |= 1;
+            cycles += 3+5;                    // SBC INC
+        } else {
+            st &= ~ST_C;
+            cycles += 1;                      // BCC taken
+        }
+        cycles += 2+3;                        // DEX BNE
+    }
+    zp24_set(ZP_ACC0, ZP_ACC1, ZP_ACC2, acc);
+    a = r;
+    x = 0;
+    status = nz(st, 0);
+    return cycles - 1;                        // last BNE not taken
+}
+
+static int hle_div_u8() {
+    if (status & ST_D) return -1;
+    zp_set(ZP_TERM0, a);
+    return div_u8_loop(a, 3+2+2);             // STA LDA LDX
+}
+
+static int hle_div_u8_en() {
+    if (status & ST_D) return -1;
+    return div_u8_loop(zp(ZP_TERM0), 2+2);    // LDA LDX
+}
+
+// div_u24: Acc=dividend, Term=divisor -> Acc=quotient, BCD=remainder
+static int hle_div_u24() {
+    if (status & ST_D) return -1;
+    if (!(zp(ZP_TERM1) | zp(ZP_TERM2))) {
+        return div_u8_loop(zp(ZP_TERM0), 3+3+3+2+2);  // LDA ORA BEQ -> div_u8_en
+    }
+    uint32_t acc = zp24(ZP_ACC0, ZP_ACC1, ZP_ACC2);
+    uint32_t term = zp24(ZP_TERM0, ZP_TERM1, ZP_TERM2);
+    uint32_t rem = 0;
+    uint8_t st = status, r = 0;
+    int cycles = 3+3+2+2+3+3+3+2;             // LDA ORA BEQ LDA STA STA STA LDX
+    for (int i=0; i<24; i++) {
+        rem = ((rem << 1) | (acc >> 23)) & 0xFFFFFF;
+        acc = (acc << 1) & 0xFFFFFF;
+        cycles += 6*5;                        // ASL ROL ROL ROL ROL ROL
+        // compare high to low byte, as the CMP chain does
+        uint8_t rb[3] = { rem & 0xFF, (rem >> 8) & 0xFF, rem >> 16 };
+        uint8_t tb[3] = { term & 0xFF, (term >> 8) & 0xFF, term >> 16 };
+        int ge = 0, k = 2;
+        for (;;) {
+            r = rb[k];
+            cycles += 3+3;                    // LDA CMP
+            if (rb[k] < tb[k]) { cycles += 3; break; }            // BCC taken
+            if (k == 0) { ge = 1; cycles += 2; break; }           // BCC not taken
+            if (rb[k] > tb[k]) { ge = 1; cycles += 2+3; break; }  // BNE taken
+            cycles += 2+2;
+            k--;
+        }
+        if (ge) {
+            st |= ST_C;
+            rb[0] = sbc(&st, rb[0], tb[0]);
+            rb[1] = sbc(&st, rb[1], tb[1]);
+            rb[2] = sbc(&st, rb[2], tb[2]);
+            r = rb[2];
+            rem = rb[0] | rb[1] << 8 | (uint32_t)rb[2] << 16;
+            acc |= 1;
+            cycles += 2+9+9+9+5;              // SEC 3x(LDA SBC STA) INC
+        } else {
+            st &= ~ST_C;
+        }
+        cycles += 2+3;                        // DEX BNE
+    }
+    zp24_set(ZP_ACC0, ZP_ACC1, ZP_ACC2, acc);
+    zp24_set(ZP_B, ZP_C, ZP_D, rem);
+    a = r;
+    x = 0;
+    status = nz(st, 0);
+    return cycles - 1;
+}
+
+// mul_u24: Acc=multiplier, Term=multiplicand -> BCD=product
+static int hle_mul_u24() {
+    if (status & ST_D) return -1;
+    uint32_t acc = zp24(ZP_ACC0, ZP_ACC1, ZP_ACC2);
+    uint32_t term = zp24(ZP_TERM0, ZP_TERM1, ZP_TERM2);
+    uint32_t prod = 0;
+    uint8_t st = status & ~ST_C, r = 0;
+    int cycles = 2+3+3+3+2+2;                 // LDA STA STA STA LDX CLC
+    for (int i=0; i<24; i++) {
+        if (st & ST_C) return -1;             // err_ovf: the multiplicand overflowed
+        int bit = acc & 1;
+        acc >>= 1;
+        cycles += 2+5+5+5+2;                  // BCS LSR ROR ROR BCC
+        if (bit) {
+            st &= ~ST_C;
+            uint8_t p0 = adc(&st, prod & 0xFF, term & 0xFF);
+            uint8_t p1 = adc(&st, (prod >> 8) & 0xFF, (term >> 8) & 0xFF);
+            uint8_t p2 = adc(&st, prod >> 16, term >> 16);
+            if (st & ST_C) return -1;         // err_ovf: the product overflowed
+            prod = p0 | p1 << 8 | (uint32_t)p2 << 16;
+            r = p2;
+            cycles += 2+9+9+9+2;              // CLC 3x(LDA ADC STA) BCS
+        } else {
+            cycles += 1;                      // BCC taken
+        }
+        st = (st & ~ST_C) | ((term >> 23) & 1);
+        term = (term << 1) & 0xFFFFFF;
+        cycles += 5+5+5+2+3;                  // ASL ROL ROL DEX BNE
+    }
+    zp24_set(ZP_ACC0, ZP_ACC1, ZP_ACC2, acc);
+    zp24_set(ZP_TERM0, ZP_TERM1, ZP_TERM2, term);
+    zp24_set(ZP_B, ZP_C, ZP_D, prod);
+    a = r;
+    x = 0;
+    status = nz(st, 0);
+    return cycles - 1;
+}
+
+// num_u24: from (Ptr),Y -> Acc, Y=end (declines on overflow: err_ovf)
+static int num_u24_body(int cycles) {
+    if (status & ST_D) return -1;
+    uint16_t ptr = zp16(ZP_PTR);
+    uint32_t acc = 0, term = zp24(ZP_TERM0, ZP_TERM1, ZP_TERM2);
+    uint8_t yy = y - 1, xx = x, st = status, res;
+    cycles += 2+3+3+3+3+2;                    // LDA STA STA STA STA DEY
+    for (;;) {
+        yy++;
+        uint8_t ch = read6502(ptr + yy);
+        st |= ST_C;
+        res = sbc(&st, ch, 48);
+        cycles += 2+5+2+2+2+2 + cross(ptr, yy);  // INY LDA SEC SBC CMP BCS
+        if (res >= 10) break;
+        xx = res;
+        if (acc & 0x800000) return -1;
+        acc <<= 1;
+        term = acc;
+        if (acc & 0x800000) return -1;
+        acc <<= 1;
+        if (acc & 0x800000) return -1;
+        acc <<= 1;
+        // CLC; TXA; ADC Acc0; ADC Term0; ... (the first carry is only worth 1)
+        st &= ~ST_C;
+        uint8_t lo = adc(&st, xx, acc & 0xFF);
+        lo = adc(&st, lo, term & 0xFF);
+        uint8_t mid = adc(&st, (acc >> 8) & 0xFF, (term >> 8) & 0xFF);
+        uint8_t hi = adc(&st, (acc >> 16) & 0xFF, term >> 16);
+        if (st & ST_C) return -1;
+        acc = lo | mid << 8 | (uint32_t)hi << 16;
+        cycles += 2+15+2+18+15+2+15+2+2+2+3+3+3+9+9+3;  // TAX ... BCC taken
+    }
+    cycles += 1;                              // BCS taken
+    zp24_set(ZP_ACC0, ZP_ACC1, ZP_ACC2, acc);
+    zp_set(ZP_ACCE, 0);
+    zp24_set(ZP_TERM0, ZP_TERM1, ZP_TERM2, term);
+    a = res;
+    x = xx;
+    y = yy;
+    status = nz(st, (uint8_t)(res - 10)) | ST_C;
+    return cycles;
+}
+
+static int hle_num_u24() {
+    return num_u24_body(0);
+}
+
+static int hle_num_u24_lb() {
+    if (status & ST_D) return -1;
+    uint8_t ptr = zp(ZP_PTR), ptrh = zp(ZP_PTRH);
+    zp_set(ZP_PTR, 0);
+    zp_set(ZP_PTRH, BAS_LINEBUF >> 8);
+    int cycles = num_u24_body(2+3+2+3);       // LDA STA LDA STA
+    if (cycles < 0) {
+        zp_set(ZP_PTR, ptr);
+        zp_set(ZP_PTRH, ptrh);
+    }
+    return cycles;
+}
+
+// copies may not touch the zero page (the pointers live there) or wrap around
+static int copy_ok(uint16_t src, uint16_t dst, uint32_t span) {
+    return src >= 0x100 && dst >= 0x100 && src + span <= 0x10000 && dst + span <= 0x10000;
+}
+
+// mcopyf: forwards from (Src) to (Dst), XY=size
+static int mcopyf_body(int cycles) {
+    uint8_t xx = x, yy = y, f;
+    uint16_t src = zp16(ZP_SRC), dst = zp16(ZP_DST);
+    cycles += 2+2;                            // TYA BEQ
+    if (yy) { xx++; cycles += 2; } else cycles += 1;   // INX, or BEQ taken
+    f = xx;
+    if (!f) return -1;                        // 64K copy
+    uint32_t n = (uint32_t)(f - (yy ? 1 : 0)) * 256 + yy;
+    if (!copy_ok(src, dst, n)) return -1;
+    cycles += 3+2+2;                          // STX TAX LDY
+    xx = yy;
+    yy = 0;
+    uint8_t v = 0;
+    for (;;) {
+        uint16_t from = src + yy, to = dst + yy;
+        v = read6502(from);
+        write6502(to, v);
+        cycles += 5+6+2+2 + cross(src, yy);   // LDA STA INY BEQ
+        yy++;
+        if (!yy) {
+            src += 256;
+            dst += 256;
+            cycles += 1+5+5+3;                // BEQ taken, INC INC JMP
+        }
+        xx--;
+        cycles += 2+3;                        // DEX BNE
+        if (xx) continue;
+        f--;
+        cycles += -1+5+3;                     // BNE not taken, DEC BNE
+        if (!f) break;
+    }
+    zp_set(ZP_SRCH, src >> 8);
+    zp_set(ZP_DSTH, dst >> 8);
+    zp_set(ZP_F, 0);
+    a = v;
+    x = 0;
+    y = yy;
+    status = nz(status, 0);
+    return cycles - 1;                        // last BNE not taken
+}
+
+static int hle_mcopyf() {
+    return mcopyf_body(0);
+}
+
+// mcopyb: backwards from (Src) to (Dst), XY=size (advances to the last page first)
+static int mcopyb_body(int cycles) {
+    if (status & ST_D) return -1;
+    uint8_t st = status, yy = y, f = x;
+    uint8_t srch = zp(ZP_SRCH), dsth = zp(ZP_DSTH);
+    st &= ~ST_C;
+    srch = adc(&st, srch, f);
+    dsth = adc(&st, dsth, f);                 // no CLC
+    cycles += 3+3+2+3+3+3+3+3+2+2;            // STX LDA CLC ADC STA LDA ADC STA TYA BEQ
+    if (yy) { f++; cycles += 5; } else cycles += 1;
+    if (!f) return -1;                        // 64K copy
+    uint16_t src = srch << 8 | zp(ZP_SRC), dst = dsth << 8 | zp(ZP_DST);
+    uint16_t src_lo = src - (f - 1) * 256, dst_lo = dst - (f - 1) * 256;
+    if (src < (f - 1) * 256 || dst < (f - 1) * 256 || !copy_ok(src_lo, dst_lo, (uint32_t)f * 256)) return -1;
+    for (;;) {
+        yy--;
+        write6502(dst + yy, read6502(src + yy));
+        cycles += 2+5+6+2+3 + cross(src, yy); // DEY LDA STA TYA BNE
+        if (yy) continue;
+        src -= 256;
+        dst -= 256;
+        f--;
+        cycles += -1+5+5+5+3;                 // BNE not taken, DEC DEC DEC BNE
+        if (!f) break;
+    }
+    zp_set(ZP_SRCH, src >> 8);
+    zp_set(ZP_DSTH, dst >> 8);
+    zp_set(ZP_F, 0);
+    a = 0;
+    y = 0;
+    status = nz(st, 0);
+    return cycles - 1;
+}
+
+static int hle_mcopyb() {
+    return mcopyb_body(0);
+}
+
+// mem_copy: (Src) to (Dst), XY=size, in the direction that is safe for overlaps
+static int mem_copyf(int cycles) {
+    uint8_t st = status;
+    status &= ~ST_C;                          // BCC taken
+    cycles = mcopyf_body(cycles);
+    if (cycles < 0) status = st;
+    return cycles;
+}
+
+static int hle_mem_copy() {
+    uint8_t sh = zp(ZP_SRCH), dh = zp(ZP_DSTH), sl = zp(ZP_SRC), dl = zp(ZP_DST);
+    if (dh != sh) {
+        if (dh < sh) return mem_copyf(3+3+3); // LDA CMP BCC
+        return mcopyb_body(3+3+2+3);          // LDA CMP BCC BNE
+    }
+    if (dl < sl) return mem_copyf(3+3+2+2+3+3+3);
+    if (dl > sl) return mcopyb_body(3+3+2+2+3+3+2+3);
+    a = dl;
+    status = nz(status, 0) | ST_C;
+    return 3+3+2+2+3+3+2+2;
+}
+
+// wrchr: printable characters that stay on the text page (no control codes or scrolling)
+static int hle_wrchr() {
+    uint16_t txtp = zp16(ZP_TXTP);
+    if (a < 32 || (txtp & 0xFF) == 0xFF) return -1;
+    write6502(txtp, a);
+    zp_set(ZP_TXTP, (txtp + 1) & 0xFF);
+    x = 0;
+    status = nz(status, (txtp + 1) & 0xFF) | ST_C;
+    return 2+2+2+6+5+2;                       // CMP BCC LDX STA INC BEQ
+}
+
+static const hle_sig HleSigs[] = {
+    { "mul_u24",    "A9 00 85 C6 85 C7 85 C8 A2 18 18 B0 xx 46 CD 66 CE 66 CF", 0, hle_mul_u24 },
+    { "div_u8",     "85 C3 A9 00 A2 18 06 CF 26 CE 26 CD 2A C5 C3 90", 0, hle_div_u8 },
+    { "div_u8_en",  "85 C3 A9 00 A2 18 06 CF 26 CE 26 CD 2A C5 C3 90", 2, hle_div_u8_en },
+    { "div_u24",    "A5 C2 05 C1 F0 xx A9 00 85 C6 85 C7 85 C8 A2 18", 0, hle_div_u24 },
+    { "num_u24",    "A9 00 85 CF 85 CE 85 CD 85 CC 88 C8 B1 C4 38 E9 30 C9 0A B0", 0, hle_num_u24 },
+    { "num_u24_lb", "A9 01 85 C5 A9 00 85 C4 A9 00 85 CF 85 CE 85 CD 85 CC 88 C8 B1 C4", 0, hle_num_u24_lb },
+    { "mem_copy",   "A5 C3 C5 C1 90 xx D0 xx A5 C2 C5 C0 90 xx D0 xx 60", 0, hle_mem_copy },
+    { "mcopyf",     "98 F0 01 E8 86 CA AA A0 00 B1 C0 91 C2 C8 F0 xx CA D0 F6 C6 CA D0 F2 60", 0, hle_mcopyf },
+    { "mcopyb",     "86 CA A5 C1 18 65 CA 85 C1 A5 C3 65 CA 85 C3 98 F0 02 E6 CA 88 B1 C0 91 C2 98 D0 F8", 0, hle_mcopyb },
+    { "wrchr",      "C9 20 90 xx A2 00 81 D8 E6 D8 F0 xx 60", 0, hle_wrchr },
+};
+
+// ---- framework ----
+
+int hle_add(uint16_t addr, const char* name, hle_fn fn, uint8_t flags) {
+    if (!addr) return 0;
+    hle_entry* e = 0;
+    for (unsigned i=0; i<HleCount && !e; i++) if (HleTab[i].addr == addr) e = &HleTab[i];  // replace
+    if (!e && HleCount >= HLE_MAX) return 0;
+    if (!e) e = &HleTab[HleCount++];
+    memset(e, 0, sizeof(*e));
+    e->addr = addr;
+    e->name = name;
+    e->fn = fn;
+    e->flags = flags;
+    HleMap[addr >> 3] |= 1 << (addr & 7);
+    return 1;
+}
+
+static int hle_match(unsigned ofs, const char* sig) {
+    for (const char* p=sig; *p; ofs++) {
+        if (ofs >= sizeof(SysROM)) return 0;
+        if (p[0] != 'x') {
+            unsigned b = (unsigned)strtoul(p, 0, 16);
+            if (SysROM[ofs] != b) return 0;
+        }
+        p += 2;
+        while (*p == ' ') p++;
+    }
+    return 1;
+}
+
+// find the ROM routines: BasROM at $C000 and the SysROM copy at $F800
+void hle_init() {
+    for (unsigned s=0; s<sizeof(HleSigs)/sizeof(HleSigs[0]); s++) {
+        for (unsigned ofs=0; ofs<sizeof(SysROM); ofs++) {
+            if (ofs == 0x1000) ofs = 0x3800;  // skip the mirrors
+            if (!hle_match(ofs, HleSigs[s].bytes)) continue;
+            hle_add((uint16_t)(0xC000 + ofs + HleSigs[s].entry), HleSigs[s].name, HleSigs[s].fn, HLE_ROM);
+            break;
+        }
+    }
+    unsigned n = 0;
+    for (unsigned i=0; i<HleCount; i++) n += (HleTab[i].flags & HLE_ROM) != 0;
+    printf("hle: %u ROM routines\n", n);
+}
+
+static void hle_rts() {
+    uint16_t lo = read6502(0x100 + (uint8_t)(sp + 1));
+    uint16_t hi = read6502(0x100 + (uint8_t)(sp + 2));
+    sp += 2;
+    pc = (uint16_t)((hi << 8 | lo) + 1);
+}
+
+typedef struct hle_regs {
+    uint16_t pc;
+    uint8_t a, x, y, sp, status;
+} hle_regs;
+
+static void hle_get(hle_regs* r) {
+    r->pc = pc; r->a = a; r->x = x; r->y = y; r->sp = sp; r->status = status;
+}
+
+static void hle_put(const hle_regs* r) {
+    pc = r->pc; a = r->a; x = r->x; y = r->y; sp = r->sp; status = r->status;
+}
+
+// run the handler and the ROM code from the same state; keep the ROM's result
+static int hle_check(hle_entry* e) {
+    static uint8_t ram[8*1024], cart[8*1024], hram[8*1024], hcart[8*1024];
+    hle_regs in, out;
+    hle_get(&in);
+    memcpy(ram, MainRAM, sizeof(ram));
+    memcpy(cart, CartRAM, sizeof(cart));
+    int cycles = e->fn();
+    if (cycles < 0) {
+        e->declined++;
+        return 0;
+    }
+    hle_rts();
+    hle_get(&out);
+    memcpy(hram, MainRAM, sizeof(hram));
+    memcpy(hcart, CartRAM, sizeof(hcart));
+    hle_put(&in);
+    memcpy(MainRAM, ram, sizeof(ram));
+    memcpy(CartRAM, cart, sizeof(cart));
+    // the ROM code, until it returns to the caller
+    uint32_t start = clockticks6502;
+    uint8_t irq = pend_irq;
+    pend_irq = 0;
+    do {
+        step6502();
+    } while (!(sp == (uint8_t)(in.sp + 2) && pc == out.pc) && clockticks6502 - start < HLE_CHECK_MAX);
+    pend_irq |= irq;
+    uint32_t took = clockticks6502 - start;
+    e->calls++;
+    e->charged += cycles + HLE_RTS;
+    e->measured += took;
+    int bad = pc != out.pc || a != out.a || x != out.x || y != out.y || sp != out.sp || status != out.status;
+    int at = -1;
+    for (unsigned i=0; i<sizeof(hram) && at < 0; i++) if (hram[i] != MainRAM[i]) at = i;
+    for (unsigned i=0; i<sizeof(hcart) && at < 0; i++) if (hcart[i] != CartRAM[i]) at = 0x2000 + i;
+    if (bad || at >= 0 || took != (uint32_t)cycles + HLE_RTS) {
+        if (e->mismatches++ < 10) {
+            printf("hle: %s mismatch: A=%02X/%02X X=%02X/%02X Y=%02X/%02X P=%02X/%02X PC=%04X/%04X cycles %u/%u",
+                e->name, out.a, a, out.x, x, out.y, y, out.status, status, out.pc, pc, cycles + HLE_RTS, took);
+            if (at >= 0) printf(" RAM $%04X", at);
+            printf(" (native/ROM)\n");
+        }
+    }
+    return 1;
+}
+
+// CPU at an address in HleMap
+int hle_trap() {
+    hle_entry* e = 0;
+    for (unsigned i=0; i<HleCount; i++) {
+        if (HleTab[i].addr == pc) { e = &HleTab[i]; break; }
+    }
+    if (!e) return 0;
+    if (e->flags & HLE_ROM) {
+        if (HleMode == HLE_OFF) return 0;
+        if (HleMode == HLE_CHECK) return hle_check(e);
+    }
+    int cycles = e->fn();
+    if (cycles < 0) {
+        e->declined++;
+        return 0;
+    }
+    hle_rts();
+    cycles = ((e->flags & HLE_ROM) && HleMode == HLE_FAST) ? HLE_RTS : cycles + HLE_RTS;
+    clockticks6502 += cycles;
+    e->calls++;
+    e->charged += cycles;
+    return 1;
+}
+
+void hle_report() {
+    if (HleMode == HLE_OFF) return;
+    printf("hle: routine      calls   declined  cycles/call");
+    printf(HleMode == HLE_CHECK ? "  (ROM)  mismatches\n" : "\n");
+    for (unsigned i=0; i<HleCount; i++) {
+        const hle_entry* e = &HleTab[i];
+        if (!(e->flags & HLE_ROM)) continue;
+        printf("  %-12s %9u %9u %10.1f", e->name, e->calls, e->declined, e->calls ? (double)e->charged / e->calls : 0.0);
+        if (HleMode == HLE_CHECK) printf(" %8.1f %9u", e->calls ? (double)e->measured / e->calls : 0.0, e->mismatches);
+        printf("\n");
+    }
+}
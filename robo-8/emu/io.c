@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 size_t read_binary_file(const char *filename, char* buffer, size_t buf_size) {
     FILE *file = fopen(filename, "rb");
@@ -41,3 +42,118 @@ size_t read_binary_file(const char *filename, char* buffer, size_t buf_size) {
     fclose(file);
     return (size_t)size;
 }
+
+// Memory-mapped images (cartridges, expansion ROM/RAM)
+//
+// ROM images are mapped read-only and shared, so startup does no copying and
+// every emulator process shares one page-cache copy. Battery-backed RAM is
+// mapped read/write and shared; sync_binary_files() flushes it to disk.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum map_const {
+    MAX_MAPPED = 16,      // writable mappings tracked for msync
+};
+
+typedef struct mapped_file {
+    void* mem;
+    size_t size;
+} mapped_file;
+
+static mapped_file Mapped[MAX_MAPPED];
+static int NumMapped = 0;
+
+size_t binary_file_size(const char *filename) {
+    struct stat st;
+    if (stat(filename, &st) != 0) return 0;
+    return (size_t)st.st_size;
+}
+
+static size_t page_round(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) & ~(page - 1);
+}
+
+// Map `size` bytes of a file. Read-only images are padded with $FF past the
+// end of the file: whole pages are shared with the file and a partial last
+// page is copied. Writable images are created or extended to `size`.
+uint8_t* map_binary_file(const char *filename, size_t size, int writable) {
+    int fd = open(filename, writable ? O_RDWR|O_CREAT : O_RDONLY, 0644);
+    if (fd < 0) {
+        perror("open");
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("fstat");
+        close(fd);
+        return 0;
+    }
+    size_t file_size = (size_t)st.st_size;
+    uint8_t* mem = 0;
+    if (writable) {
+        if (NumMapped >= MAX_MAPPED) {
+            fprintf(stderr, "%s: too many RAM images\n", filename);
+            close(fd);
+            return 0;
+        }
+        if (file_size < size && ftruncate(fd, (off_t)size) != 0) {
+            perror("ftruncate");
+            close(fd);
+            return 0;
+        }
+        void* m = mmap(0, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) {
+            perror("mmap");
+            close(fd);
+            return 0;
+        }
+        mem = (uint8_t*)m;
+        Mapped[NumMapped].mem = m;
+        Mapped[NumMapped].size = size;
+        NumMapped++;
+    } else {
+        if (file_size > size) {
+            fprintf(stderr, "%s too big\n", filename);
+            close(fd);
+            return 0;
+        }
+        // reserve the whole range as $FF, copy in the partial last page,
+        // then map the whole pages of the file over the start
+        size_t span = page_round(size);
+        size_t whole = file_size & ~((size_t)sysconf(_SC_PAGESIZE) - 1);
+        void* m = mmap(0, span, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+        if (m == MAP_FAILED) {
+            perror("mmap");
+            close(fd);
+            return 0;
+        }
+        memset(m, 0xFF, span);
+        if (file_size > whole && pread(fd, (uint8_t*)m + whole, file_size - whole, (off_t)whole) != (ssize_t)(file_size - whole)) {
+            perror("pread");
+            munmap(m, span);
+            close(fd);
+            return 0;
+        }
+        mprotect(m, span, PROT_READ);
+        if (whole && mmap(m, whole, PROT_READ, MAP_SHARED|MAP_FIXED, fd, 0) == MAP_FAILED) {
+            perror("mmap");
+            munmap(m, span);
+            close(fd);
+            return 0;
+        }
+        mem = (uint8_t*)m;
+    }
+    close(fd); // the mapping keeps the file open
+    return mem;
+}
+
+// Flush battery-backed RAM images to disk (wait=0 schedules the writes).
+void sync_binary_files(int wait) {
+    for (int i=0; i<NumMapped; i++) {
+        msync(Mapped[i].mem, Mapped[i].size, wait ? MS_SYNC : MS_ASYNC);
+    }
+}
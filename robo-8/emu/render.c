@@ -171,6 +171,11 @@ void render() {
     SDL_RenderPresent(renderer); // wait for VSync (snap to 60fps)
 }
 
+// pixel within the current line, for the IO log.
+uint16_t vdp_hpos() {
+    return vdp_hcount;
+}
+
 // advance the renderer to catch up with the CPU clock (clockticks6502)
 // the current vdp_clk has already been processed
 void advance_vdp() {
@@ -10,8 +10,71 @@
 const Uint8 *keys = 0;
 static Uint8 dbg_mode = 1;
 
+// Map a cartridge image at `slot`, spanning as many 8K slots as the file needs.
+// ROM is mapped read-only; battery RAM is read/write (at least one slot).
+static int map_cart(unsigned slot, const char* filename, int ram) {
+    size_t slots = (binary_file_size(filename) + 0x1FFF) >> 13;
+    if (ram && !slots) slots = 1;
+    if (slot >= 8 || !slots || slot + slots > 8) {
+        printf("cannot map %s at slot %u\n", filename, slot);
+        return 0;
+    }
+    uint8_t* mem = map_binary_file(filename, slots << 13, ram);
+    if (!mem) return 0;
+    for (size_t i=0; i<slots; i++) {
+        ula_map_slot(slot+i, mem + (i << 13), ram);
+    }
+    printf("mapped %s at slot %u (%zuK %s)\n", filename, slot, slots*8, ram ? "RAM" : "ROM");
+    return 1;
+}
+
 int main(int argc, char *argv[]) {
-    (void)argc; (void)argv;
+    // command line:
+    //   -cart SLOT FILE  map a ROM cartridge image at SLOT (8K slots; 1-5 are expansion)
+    //   -bram SLOT FILE  map a battery-backed RAM image at SLOT
+    //   -iolog PORTS FILE  log IO events for PORTS ("all" or e.g. "F8-FA"), dumped to FILE
+    //   -basic FILE      load a BASIC program into RAM once the ROM has booted
+    //   -basicverify     also check each line against the ROM tokenizer
+    //   -tape FILE       tape image (.wav, or raw 1-bit samples); F2 play, F3 record, F4 rewind
+    //   -tapeslow        no LOAD/SAVE traps: the tape only moves in real time
+    //   -serial BAUD     bridge the serial port to a new PTY (path printed)
+    //   -serialtrap PUT,GET  byte-level serial routines to trap (hex addresses)
+    //   -hle MODE        native ROM routines: off, on, fast (RTS cycles only), check
+    const char* iolog_file = 0;
+    const char* basic_file = 0;
+    int basic_verify = 0;
+    const char* tape_file = 0;
+    int tape_fast = 1;
+    uint32_t serial_baud = 0;
+    for (int i=1; i<argc; i++) {
+        if ((!strcmp(argv[i], "-cart") || !strcmp(argv[i], "-bram")) && i+2 < argc) {
+            map_cart((unsigned)atoi(argv[i+1]), argv[i+2], argv[i][1] == 'b');
+            i += 2;
+        } else if (!strcmp(argv[i], "-iolog") && i+2 < argc) {
+            IoLogMask = iolog_ports(argv[i+1]);
+            iolog_file = argv[i+2];
+            i += 2;
+        } else if (!strcmp(argv[i], "-basic") && i+1 < argc) {
+            basic_file = argv[++i];
+        } else if (!strcmp(argv[i], "-basicverify")) {
+            basic_verify = 1;
+        } else if (!strcmp(argv[i], "-tape") && i+1 < argc) {
+            tape_file = argv[++i];
+        } else if (!strcmp(argv[i], "-tapeslow")) {
+            tape_fast = 0;
+        } else if (!strcmp(argv[i], "-serial") && i+1 < argc) {
+            serial_baud = (uint32_t)atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-serialtrap") && i+1 < argc) {
+            unsigned put = 0, get = 0;
+            sscanf(argv[++i], "%x,%x", &put, &get);
+            SerTrap[0] = (uint16_t)put;
+            SerTrap[1] = (uint16_t)get;
+        } else if (!strcmp(argv[i], "-hle") && i+1 < argc) {
+            const char* mode = argv[++i];
+            HleMode = !strcmp(mode, "on") ? HLE_ON : !strcmp(mode, "fast") ? HLE_FAST :
+                      !strcmp(mode, "check") ? HLE_CHECK : HLE_OFF;
+        }
+    }
 
      char cwd[PATH_MAX];
     if (!getcwd(cwd, sizeof(cwd))) { cwd[0] = 'X'; cwd[1] = 0; }
@@ -24,6 +87,9 @@ int main(int argc, char *argv[]) {
     memcpy(SysROM+0x3000, SysROM+0x1000, 0x800);  // 2K SysROM -> top 4K (mirror)
     memcpy(SysROM+0x1000, SysROM+0x0000, 0x1000); // 4K BasROM -> bottom 8K (mirror)
     printf("loaded ROM %zu\n", rom_size);
+    if (HleMode != HLE_OFF) hle_init();
+    if (tape_file && !tape_open(tape_file, tape_fast)) return 1;
+    if (serial_baud && !serial_open(serial_baud)) return 1;
 
     // create window.
     if (!init_render()) {
@@ -46,12 +112,32 @@ int main(int argc, char *argv[]) {
     // run the simulator.
     SDL_Event event;
     int running = 1;
+    Uint32 sync_time = SDL_GetTicks() + 1000;
     while (running) {
+        // flush battery RAM once a second.
+        if (SDL_GetTicks() >= sync_time) {
+            sync_binary_files(0);
+            sync_time = SDL_GetTicks() + 1000;
+        }
+
         // process events.
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
                 running = 0;
             }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F11 && iolog_file) {
+                iolog_dump(iolog_file); // IO log on request
+            }
+            if (event.type == SDL_KEYDOWN && tape_file) {
+                switch (event.key.keysym.sym) {
+                    case SDLK_F2: tape_mode(tape_state() == TAPE_PLAY ? TAPE_STOP : TAPE_PLAY); break;
+                    case SDLK_F3:
+                        tape_mode(tape_state() == TAPE_REC ? TAPE_STOP : TAPE_REC);
+                        if (tape_state() == TAPE_STOP) tape_close();
+                        break;
+                    case SDLK_F4: tape_rewind(); break;
+                }
+            }
         }    
 
         // run the CPU.
@@ -92,10 +178,26 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        // BASIC program: the ROM has set up video memory once it scans the keyboard.
+        if (basic_file && KbdReads) {
+            Uint64 t0 = SDL_GetPerformanceCounter();
+            int lines = basic_load(basic_file, basic_verify);
+            double us = (SDL_GetPerformanceCounter() - t0) * 1e6 / SDL_GetPerformanceFrequency();
+            if (lines >= 0) printf("loaded %s: %d lines in %.0f us\n", basic_file, lines, us);
+            basic_file = 0;
+        }
+
+        serial_poll();
+
         // make render progress.
         advance_vdp();
     }
 
+    sync_binary_files(1);
+    if (iolog_file) iolog_dump(iolog_file);
+    tape_close();
+    serial_close();
+    hle_report();
     final_render();
     return 0;
 }
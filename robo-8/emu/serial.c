@@ -0,0 +1,189 @@
+// Robo Emulator - Serial Port
+
+// The RS-232 module's lines on IO_DATA are bridged to a host pseudo-terminal.
+// Bit level: TXD (bit 1) is sampled like a UART at SerBaud (1 start bit, 8 data bits
+// LSB first, 1 stop bit; 1 = mark) and the bytes go to the PTY. Bytes from the PTY
+// are shifted out on RXD (bit 1) once the machine reads IO_DATA with RTS (bit 2) set.
+// CTS (bit 2) reads 1 while the output buffer has room.
+//
+// Fast path: the ROM has no serial routines yet, so the byte-level entry points
+// are given with -serialtrap PUT,GET and trapped as HLE handlers:
+//   PUT  A = byte; returns CC (CS when the output buffer is full)
+//   GET  returns A = byte and CC, or CS when nothing is waiting (does not block)
+// The PTY is non-blocking and polled once per millisecond of emulated time.
+
+#define _GNU_SOURCE   // posix_openpt, ptsname, cfmakeraw on glibc
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "header.h"
+
+enum ser_const {
+    SER_BUF        = 4096,    // each direction
+    SER_FRAME      = 10,      // start, 8 data, stop
+    SER_POLL       = cpu_clk / 1000,
+    SER_RTS        = 0x04,    // IO_DATA bits
+    SER_TXD        = 0x02,
+    SER_CTS        = 0x04,
+    SER_RXD        = 0x02,
+    FLAG_CARRY     = 0x01,
+};
+
+typedef struct ser_fifo {
+    uint8_t buf[SER_BUF];
+    uint32_t head, tail;      // free running
+} ser_fifo;
+
+uint16_t SerTrap[2] = { 0, 0 };       // PUT, GET entry points (0 = none)
+uint32_t SerBaud = 1200;
+
+static int SerFd = -1;
+static ser_fifo SerOut, SerIn;
+static uint32_t SerBit;               // CPU cycles per bit
+static uint32_t SerPollClk;
+static uint8_t SerRTS = 0;
+// transmitter (machine -> host)
+static uint8_t TxLevel = 1;
+static uint8_t TxActive = 0;
+static uint8_t TxNext;                // next bit to sample
+static uint16_t TxShift;
+static uint32_t TxStart;
+// receiver (host -> machine)
+static uint8_t RxActive = 0;
+static uint8_t RxByte;
+static uint32_t RxStart;
+
+static uint32_t fifo_count(const ser_fifo* f) { return f->head - f->tail; }
+
+static int fifo_put(ser_fifo* f, uint8_t b) {
+    if (fifo_count(f) >= SER_BUF) return 0;
+    f->buf[f->head++ % SER_BUF] = b;
+    return 1;
+}
+
+static int fifo_get(ser_fifo* f, uint8_t* b) {
+    if (!fifo_count(f)) return 0;
+    *b = f->buf[f->tail++ % SER_BUF];
+    return 1;
+}
+
+static int serial_trap();
+
+int serial_open(uint32_t baud) {
+    SerBaud = baud ? baud : SerBaud;
+    SerBit = cpu_clk / SerBaud;
+    SerFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (SerFd < 0 || grantpt(SerFd) || unlockpt(SerFd)) {
+        perror("serial: posix_openpt");
+        return 0;
+    }
+    struct termios tio;
+    if (!tcgetattr(SerFd, &tio)) {
+        cfmakeraw(&tio);
+        tcsetattr(SerFd, TCSANOW, &tio);
+    }
+    fcntl(SerFd, F_SETFL, fcntl(SerFd, F_GETFL) | O_NONBLOCK);
+    hle_add(SerTrap[0], "PUT", serial_trap, 0);
+    hle_add(SerTrap[1], "GET", serial_trap, 0);
+    printf("serial: %s at %u baud", ptsname(SerFd), SerBaud);
+    if (SerTrap[0] || SerTrap[1]) printf(", PUT at $%04X, GET at $%04X", SerTrap[0], SerTrap[1]);
+    printf("\n");
+    return 1;
+}
+
+void serial_close() {
+    if (SerFd < 0) return;
+    close(SerFd);
+    SerFd = -1;
+}
+
+// move buffered bytes to and from the PTY
+static void serial_io() {
+    SerPollClk = clockticks6502;
+    while (fifo_count(&SerOut)) {
+        uint32_t at = SerOut.tail % SER_BUF;
+        uint32_t n = fifo_count(&SerOut);
+        if (n > SER_BUF - at) n = SER_BUF - at;
+        ssize_t w = write(SerFd, SerOut.buf + at, n);
+        if (w <= 0) break;    // no reader yet (EIO) or full (EAGAIN): keep the bytes
+        SerOut.tail += (uint32_t)w;
+    }
+    uint8_t buf[256];
+    uint32_t room = SER_BUF - fifo_count(&SerIn);
+    if (room > sizeof(buf)) room = sizeof(buf);
+    ssize_t r = room ? read(SerFd, buf, room) : 0;
+    for (ssize_t i=0; i<r; i++) fifo_put(&SerIn, buf[i]);
+}
+
+// sample TXD up to `now` (the line was at TxLevel until then)
+static void serial_tx(uint32_t now) {
+    while (TxActive && now - TxStart >= TxNext * SerBit + SerBit / 2) {
+        TxShift |= TxLevel << TxNext;
+        if (++TxNext == SER_FRAME) {
+            TxActive = 0;
+            if ((TxShift & 1) == 0 && (TxShift >> 9) == 1) fifo_put(&SerOut, (uint8_t)(TxShift >> 1));
+        }
+    }
+}
+
+// from the main loop
+void serial_poll() {
+    if (SerFd < 0 || clockticks6502 - SerPollClk < SER_POLL) return;
+    serial_tx(clockticks6502);
+    serial_io();
+}
+
+// IO_DATA write: bits 2 (RTS) and 1 (TXD)
+void serial_out(uint8_t value) {
+    if (SerFd < 0) return;
+    SerRTS = value & SER_RTS;
+    uint8_t level = (value & SER_TXD) ? 1 : 0;
+    if (level == TxLevel) return;
+    serial_tx(clockticks6502);
+    TxLevel = level;
+    if (!TxActive && !level) {
+        TxActive = 1;
+        TxNext = 0;
+        TxShift = 0;
+        TxStart = clockticks6502;
+    }
+}
+
+// IO_DATA read: bits 2 (CTS) and 1 (RXD)
+uint8_t serial_in() {
+    if (SerFd < 0) return SER_RXD;
+    serial_tx(clockticks6502);
+    uint8_t cts = fifo_count(&SerOut) < SER_BUF ? SER_CTS : 0;
+    if (RxActive && clockticks6502 - RxStart >= SER_FRAME * SerBit) RxActive = 0;
+    if (!RxActive && SerRTS && fifo_get(&SerIn, &RxByte)) {
+        RxActive = 1;
+        RxStart = clockticks6502;
+    }
+    if (!RxActive) return cts | SER_RXD;
+    uint32_t bit = (clockticks6502 - RxStart) / SerBit;
+    uint8_t level = bit == 0 ? 0 : bit <= 8 ? (RxByte >> (bit - 1)) & 1 : 1;
+    return cts | (level ? SER_RXD : 0);
+}
+
+// HLE handler at a SerTrap address: move one byte (hle_trap returns from the routine).
+static int serial_trap() {
+    if (SerFd < 0) return -1;
+    if (pc == SerTrap[0]) {
+        if (fifo_count(&SerOut) >= SER_BUF) serial_io();
+        if (fifo_put(&SerOut, a)) status &= ~FLAG_CARRY;
+        else status |= FLAG_CARRY;
+    } else {
+        uint8_t b;
+        if (!fifo_count(&SerIn)) serial_io();
+        if (fifo_get(&SerIn, &b)) {
+            a = b;
+            status &= ~FLAG_CARRY;
+        } else {
+            status |= FLAG_CARRY;
+        }
+    }
+    return 0;
+}
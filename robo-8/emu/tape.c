@@ -0,0 +1,414 @@
+// Robo Emulator - Tape Port
+
+// A tape is a 1-bit signal (packed LSB first) at TapeRate samples per second:
+// a raw bit stream (.bit, 44100 Hz) or a WAV file, thresholded at zero.
+// IO_DATA bit 0 reads the signal under the head (TapeIn) and records the level
+// written (TapeOut), both timed by the CPU clock: the bit-level path.
+//
+// The fast path traps the ROM's LOAD and SAVE commands (HLE handlers at the entries
+// found through tab_cmds and disp_cmds) and moves a whole block in one step.
+// Blocks are Kansas City Standard at 300 baud: 0 = 4 cycles of 1200 Hz, 1 = 8 cycles
+// of 2400 Hz, bytes framed as a 0 start bit, 8 data bits (LSB first), 2 stop bits.
+//   2s of 1s, $2A, name[16], start u16, length u16, data, checksum (sum of data)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "header.h"
+
+enum tape_const {
+    TAPE_RAW_RATE  = 44100,
+    TAPE_BAUD      = 300,
+    TAPE_SPACE_HZ  = 1200,    // 0 bit
+    TAPE_MARK_HZ   = 2400,    // 1 bit
+    TAPE_SYNC      = 0x2A,
+    TAPE_NAME      = 16,
+    TAPE_LEADER_MS = 2000,
+    TAPE_TRAILER_MS = 500,
+};
+
+uint16_t TapeTrap[2] = { 0, 0 };      // LOAD, SAVE entry points (0 = none)
+
+static uint8_t* TapeBits = 0;
+static uint32_t TapeLen = 0;          // samples
+static uint32_t TapeCap = 0;          // samples allocated
+static uint32_t TapeRate = TAPE_RAW_RATE;
+static uint32_t TapePos = 0;          // sample under the head at TapeClk
+static uint32_t TapeClk = 0;          // clockticks6502
+static uint8_t TapeMode = TAPE_STOP;
+static uint8_t TapeOut = 0;           // level being recorded
+static uint8_t TapeDirty = 0;
+static uint8_t TapeFast = 1;
+static const char* TapePath = 0;
+
+static uint32_t tape_now() {
+    if (TapeMode == TAPE_STOP) return TapePos;
+    return TapePos + (uint32_t)((uint64_t)(clockticks6502 - TapeClk) * TapeRate / cpu_clk);
+}
+
+static int tape_get(uint32_t pos) {
+    return pos < TapeLen ? (TapeBits[pos >> 3] >> (pos & 7)) & 1 : 0;
+}
+
+static int tape_grow(uint32_t len) {
+    if (len <= TapeCap) return 1;
+    uint32_t cap = TapeCap ? TapeCap : 1 << 20;
+    while (cap < len) cap *= 2;
+    uint8_t* bits = realloc(TapeBits, cap / 8 + 1);
+    if (!bits) return 0;
+    memset(bits + TapeCap / 8, 0, cap / 8 + 1 - TapeCap / 8);
+    TapeBits = bits;
+    TapeCap = cap;
+    return 1;
+}
+
+static void tape_put(uint32_t pos, int level) {
+    if (!tape_grow(pos + 1)) return;
+    if (level) TapeBits[pos >> 3] |= 1 << (pos & 7);
+    else TapeBits[pos >> 3] &= ~(1 << (pos & 7));
+    if (pos >= TapeLen) TapeLen = pos + 1;
+}
+
+// record TapeOut up to the head
+static void tape_fill() {
+    uint32_t now = tape_now();
+    for (uint32_t p=TapePos; p<now; p++) tape_put(p, TapeOut);
+    TapePos = now;
+    TapeClk = clockticks6502;
+    TapeDirty = 1;
+}
+
+// IO_DATA read: bit 0
+uint8_t tape_in() {
+    if (TapeMode != TAPE_PLAY) return 0;
+    return tape_get(tape_now());
+}
+
+// IO_DATA write: bit 0
+void tape_out(uint8_t level) {
+    if (TapeMode == TAPE_REC && level != TapeOut) tape_fill();
+    TapeOut = level;
+}
+
+void tape_mode(uint8_t mode) {
+    if (TapeMode == TAPE_REC) tape_fill();
+    TapePos = tape_now();
+    TapeClk = clockticks6502;
+    TapeMode = mode;
+    printf("tape: %s at %.1fs\n", mode == TAPE_PLAY ? "play" : mode == TAPE_REC ? "record" : "stop",
+        (double)TapePos / TapeRate);
+}
+
+uint8_t tape_state() {
+    return TapeMode;
+}
+
+void tape_rewind() {
+    tape_mode(TAPE_STOP);
+    TapePos = 0;
+}
+
+// ---- KCS blocks (fast path) ----
+
+// write a square wave of `hz` for `cycles` cycles at `*pos`
+static void kcs_tone(uint32_t* pos, unsigned hz, unsigned cycles) {
+    uint32_t half = TapeRate / (2 * hz);
+    uint64_t frac = 0;
+    for (unsigned c=0; c<cycles*2; c++) {
+        uint32_t n = half;
+        frac += TapeRate % (2 * hz);
+        if (frac >= 2 * hz) { frac -= 2 * hz; n++; }
+        for (uint32_t i=0; i<n; i++) tape_put((*pos)++, !(c & 1));
+    }
+}
+
+static void kcs_bit(uint32_t* pos, int bit) {
+    if (bit) kcs_tone(pos, TAPE_MARK_HZ, TAPE_MARK_HZ / TAPE_BAUD);
+    else kcs_tone(pos, TAPE_SPACE_HZ, TAPE_SPACE_HZ / TAPE_BAUD);
+}
+
+static void kcs_byte(uint32_t* pos, uint8_t b) {
+    kcs_bit(pos, 0);
+    for (int i=0; i<8; i++) kcs_bit(pos, (b >> i) & 1);
+    kcs_bit(pos, 1);
+    kcs_bit(pos, 1);
+}
+
+// transitions in [pos, pos+n)
+static unsigned kcs_edges(uint32_t pos, uint32_t n) {
+    unsigned edges = 0;
+    int last = tape_get(pos);
+    for (uint32_t i=1; i<n; i++) {
+        int b = tape_get(pos + i);
+        edges += b != last;
+        last = b;
+    }
+    return edges;
+}
+
+// next byte at or after `*pos`: a start bit is the first half cycle of 1200 Hz.
+static int kcs_read(uint32_t* pos, uint8_t* out) {
+    uint32_t bit = TapeRate / TAPE_BAUD;
+    uint32_t mid = TapeRate / (TAPE_SPACE_HZ + TAPE_MARK_HZ);   // between the half periods
+    uint32_t p = *pos;
+    for (;;) {
+        // find the next long half cycle
+        int level = tape_get(p);
+        uint32_t start = p;
+        while (p < TapeLen && tape_get(p) == level) p++;
+        if (p >= TapeLen) return 0;
+        if (p - start > mid && p - start < 2 * mid * 2) {
+            p = start;
+            break;
+        }
+    }
+    unsigned mark = (2 * TAPE_MARK_HZ / TAPE_BAUD + 2 * TAPE_SPACE_HZ / TAPE_BAUD) / 2;
+    uint8_t b = 0;
+    for (int i=1; i<=8; i++) {
+        if (kcs_edges(p + i * bit, bit) > mark) b |= 1 << (i - 1);
+    }
+    *pos = p + 9 * bit + bit / 2;     // into the stop bits
+    *out = b;
+    return 1;
+}
+
+// ---- ROM traps ----
+
+// entries of the ROM's LOAD and SAVE commands, as dispatched through tab_cmds
+static void tape_find_traps() {
+    for (unsigned i=0; i+5 <= 0x1000; i++) {
+        if (memcmp(SysROM + i, "LIST", 4) || SysROM[i+4] != 0xC0) continue;
+        unsigned at = i, n = 0;
+        uint16_t load = 0, save = 0;
+        uint8_t idx[2] = { 0xFF, 0xFF };
+        for (;;) {
+            unsigned name = at;
+            while (at < 0x1000 && !(SysROM[at] & 0x80)) at++;
+            if (at >= 0x1000) return;
+            if (at - name == 4 && !memcmp(SysROM + name, "LOAD", 4)) idx[0] = SysROM[at] & 0x3F;
+            if (at - name == 4 && !memcmp(SysROM + name, "SAVE", 4)) idx[1] = SysROM[at] & 0x3F;
+            n++;
+            if (!(SysROM[at++] & 0x40)) break;
+        }
+        // disp_cmds follows: low byte minus one; the page is pushed by the
+        // dispatch (LDA #page, PHA, LDA disp_cmds,X) and RTS adds one
+        uint16_t disp = 0xC000 + at, page = disp & 0xFF00;
+        for (unsigned j=0; j+6 <= 0x1000; j++) {
+            if (SysROM[j] == 0xA9 && SysROM[j+2] == 0x48 && SysROM[j+3] == 0xBD &&
+                SysROM[j+4] == (disp & 0xFF) && SysROM[j+5] == disp >> 8) page = SysROM[j+1] << 8;
+        }
+        if (idx[0] < n) load = (page | SysROM[at + idx[0]]) + 1;
+        if (idx[1] < n) save = (page | SysROM[at + idx[1]]) + 1;
+        TapeTrap[0] = load;
+        TapeTrap[1] = save;
+        return;
+    }
+}
+
+// "NAME" after the command (Y = LineBuf offset)
+static void tape_name(char name[TAPE_NAME]) {
+    memset(name, 0, TAPE_NAME);
+    unsigned ofs = y;
+    while (read6502(BAS_LINEBUF + ofs) == ' ' && ofs < 127) ofs++;
+    if (read6502(BAS_LINEBUF + ofs) != '"') return;
+    ofs++;
+    for (int i=0; i<TAPE_NAME && ofs < 127; i++, ofs++) {
+        uint8_t c = read6502(BAS_LINEBUF + ofs);
+        if (!c || c == '"') break;
+        name[i] = c;
+    }
+}
+
+static void tape_load_block() {
+    char want[TAPE_NAME];
+    tape_name(want);
+    uint32_t pos = tape_now();
+    uint8_t b;
+    while (kcs_read(&pos, &b)) {
+        if (b != TAPE_SYNC) continue;
+        uint8_t hdr[TAPE_NAME + 4];
+        int ok = 1;
+        for (unsigned i=0; i<sizeof(hdr) && ok; i++) ok = kcs_read(&pos, &hdr[i]);
+        if (!ok) break;
+        uint16_t start = hdr[TAPE_NAME] | hdr[TAPE_NAME+1] << 8;
+        uint16_t len = hdr[TAPE_NAME+2] | hdr[TAPE_NAME+3] << 8;
+        int match = !want[0] || !memcmp(want, hdr, TAPE_NAME);
+        printf("tape: %s %.16s (%u bytes at $%04X)\n", match ? "loading" : "skipping", (char*)hdr, len, start);
+        uint8_t sum = 0;
+        for (unsigned i=0; i<len && ok; i++) {
+            ok = kcs_read(&pos, &b);
+            sum += b;
+            if (match) write6502((uint16_t)(start + i), b);
+        }
+        if (!ok || !kcs_read(&pos, &b)) break;
+        if (!match) continue;
+        if (b != sum) printf("tape: checksum error\n");
+        if (start == BAS_BASE) {
+            write6502(ZP_TOPPTR, (start + len) & 0xFF);
+            write6502(ZP_TOPPTR+1, (start + len) >> 8);
+        }
+        TapePos = pos;
+        TapeClk = clockticks6502;
+        return;
+    }
+    printf("tape: no block found\n");
+    TapePos = pos;
+    TapeClk = clockticks6502;
+}
+
+static void tape_save_block() {
+    char name[TAPE_NAME];
+    tape_name(name);
+    uint16_t start = BAS_BASE;
+    uint16_t top = read6502(ZP_TOPPTR) | read6502(ZP_TOPPTR+1) << 8;
+    uint16_t len = top > start ? top - start : 0;
+    uint32_t pos = tape_now();
+    kcs_tone(&pos, TAPE_MARK_HZ, TAPE_MARK_HZ * TAPE_LEADER_MS / 1000);
+    kcs_byte(&pos, TAPE_SYNC);
+    for (int i=0; i<TAPE_NAME; i++) kcs_byte(&pos, name[i]);
+    kcs_byte(&pos, start & 0xFF);
+    kcs_byte(&pos, start >> 8);
+    kcs_byte(&pos, len & 0xFF);
+    kcs_byte(&pos, len >> 8);
+    uint8_t sum = 0;
+    for (unsigned i=0; i<len; i++) {
+        uint8_t b = read6502((uint16_t)(start + i));
+        sum += b;
+        kcs_byte(&pos, b);
+    }
+    kcs_byte(&pos, sum);
+    kcs_tone(&pos, TAPE_MARK_HZ, TAPE_MARK_HZ * TAPE_TRAILER_MS / 1000);
+    printf("tape: saved %.16s (%u bytes)\n", name, len);
+    TapePos = pos;
+    TapeClk = clockticks6502;
+    TapeDirty = 1;
+}
+
+// HLE handler at a trap address: run the command on the host (hle_trap returns from it).
+static int tape_trap() {
+    if (!TapeFast || !TapePath) return -1;
+    if (pc == TapeTrap[0]) tape_load_block();
+    else tape_save_block();
+    return 0;
+}
+
+// ---- files ----
+
+static uint32_t rd32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+static void wr32(uint8_t* p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+
+static int tape_is_wav(const char* path) {
+    size_t n = strlen(path);
+    return n > 4 && (!strcmp(path + n - 4, ".wav") || !strcmp(path + n - 4, ".WAV"));
+}
+
+// PCM WAV, 8 or 16 bits, first channel
+static int tape_read_wav(const uint8_t* buf, size_t len) {
+    if (len < 12 || memcmp(buf, "RIFF", 4) || memcmp(buf + 8, "WAVE", 4)) return 0;
+    unsigned channels = 0, bits = 0;
+    size_t at = 12;
+    while (at + 8 <= len) {
+        uint32_t size = rd32(buf + at + 4);
+        const uint8_t* chunk = buf + at + 8;
+        if (size > len - at - 8) size = (uint32_t)(len - at - 8);
+        if (!memcmp(buf + at, "fmt ", 4) && size >= 16) {
+            if ((chunk[0] | chunk[1] << 8) != 1) return 0;    // PCM only
+            channels = chunk[2] | chunk[3] << 8;
+            TapeRate = rd32(chunk + 4);
+            bits = chunk[14] | chunk[15] << 8;
+        } else if (!memcmp(buf + at, "data", 4) && channels && (bits == 8 || bits == 16) && TapeRate) {
+            unsigned frame = channels * bits / 8;
+            uint32_t n = size / frame;
+            if (!tape_grow(n)) return 0;
+            for (uint32_t i=0; i<n; i++) {
+                const uint8_t* s = chunk + i * frame;
+                int level = bits == 8 ? s[0] >= 0x80 : (int16_t)(s[0] | s[1] << 8) >= 0;
+                tape_put(i, level);
+            }
+            return 1;
+        }
+        at += 8 + size + (size & 1);
+    }
+    return 0;
+}
+
+static int tape_write(const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return 0;
+    int ok = 1;
+    if (tape_is_wav(path)) {
+        uint8_t hdr[44];
+        memcpy(hdr, "RIFF", 4);
+        wr32(hdr + 4, 36 + TapeLen);
+        memcpy(hdr + 8, "WAVEfmt ", 8);
+        wr32(hdr + 16, 16);
+        wr32(hdr + 20, 1 | 1 << 16);          // PCM, mono
+        wr32(hdr + 24, TapeRate);
+        wr32(hdr + 28, TapeRate);             // bytes per second
+        wr32(hdr + 32, 1 | 8 << 16);          // 1 byte per frame, 8 bits
+        memcpy(hdr + 36, "data", 4);
+        wr32(hdr + 40, TapeLen);
+        ok = fwrite(hdr, sizeof(hdr), 1, f) == 1;
+        uint8_t buf[4096];
+        for (uint32_t i=0; i<TapeLen && ok; i+=sizeof(buf)) {
+            uint32_t n = TapeLen - i < sizeof(buf) ? TapeLen - i : sizeof(buf);
+            for (uint32_t j=0; j<n; j++) buf[j] = tape_get(i + j) ? 0xC0 : 0x40;
+            ok = fwrite(buf, 1, n, f) == n;
+        }
+    } else {
+        ok = fwrite(TapeBits, 1, (TapeLen + 7) / 8, f) == (TapeLen + 7) / 8;
+    }
+    if (fclose(f)) ok = 0;
+    return ok;
+}
+
+// insert a tape (created on the first recording if it does not exist)
+int tape_open(const char* path, int fast) {
+    TapePath = path;
+    TapeFast = fast;
+    TapeRate = TAPE_RAW_RATE;
+    TapeLen = TapePos = 0;
+    FILE* f = fopen(path, "rb");
+    if (f) {
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        uint8_t* buf = len > 0 ? malloc(len) : 0;
+        int ok = !len || (buf && fread(buf, 1, len, f) == (size_t)len);
+        fclose(f);
+        if (ok && tape_is_wav(path)) {
+            ok = tape_read_wav(buf, len);
+        } else if (ok) {
+            ok = tape_grow((uint32_t)len * 8);
+            if (ok && len) memcpy(TapeBits, buf, len);
+            TapeLen = (uint32_t)len * 8;
+        }
+        free(buf);
+        if (!ok) {
+            printf("cannot read tape %s\n", path);
+            return 0;
+        }
+    }
+    if (fast) {
+        tape_find_traps();
+        hle_add(TapeTrap[0], "LOAD", tape_trap, 0);
+        hle_add(TapeTrap[1], "SAVE", tape_trap, 0);
+    }
+    printf("tape %s: %.1fs at %u Hz", path, (double)TapeLen / TapeRate, TapeRate);
+    if (fast && TapeTrap[0]) printf(", LOAD at $%04X, SAVE at $%04X", TapeTrap[0], TapeTrap[1]);
+    printf("\n");
+    return 1;
+}
+
+// write the tape back if it was recorded on
+int tape_close() {
+    if (!TapePath) return 1;
+    if (TapeMode == TAPE_REC) tape_fill();
+    int ok = 1;
+    if (TapeDirty) {
+        ok = tape_write(TapePath);
+        printf(ok ? "tape: wrote %s\n" : "tape: cannot write %s\n", TapePath);
+    }
+    TapeDirty = 0;
+    return ok;
+}
@@ -26,6 +26,7 @@ uint8_t  VidPal2   = 0xC1;   // 8-bit register      (7-4:C2 3-0:C3)
 uint8_t  KbdCol    = 0x03;   // 4-bit register
 uint8_t  PSGVol    = 0x03;   // 2-bit register
 uint8_t  PSGFrq    = 0x28;   // 8-bit register
+uint32_t KbdReads  = 0;      // IO_KEYB reads (the ROM has booted)
 
 uint8_t* MemMap[8] = {
     MainRAM,               // Base 8K RAM
@@ -49,7 +50,29 @@ static uint8_t MemMapWR[8] = {
     0,                     // System ROM
 };
 
+static uint8_t Sandbox = 0;
+static uint8_t SandboxWR[8];
+
+// Run ROM code without side effects (basic.c verify): IO reads open bus and ignores
+// writes, and only Main RAM and Cart RAM (which the caller restores) can be written.
+void ula_sandbox(int on) {
+    if (on == Sandbox) return;
+    Sandbox = on;
+    for (unsigned slot=2; slot<8; slot++) {
+        if (on) SandboxWR[slot] = MemMapWR[slot];
+        MemMapWR[slot] = on ? 0 : SandboxWR[slot];
+    }
+}
+
+// Install an 8K slot: a cartridge or expansion image (0 = open bus).
+void ula_map_slot(unsigned slot, uint8_t* mem, uint8_t writable) {
+    if (slot >= 8) return;
+    MemMap[slot] = mem ? mem : OpenBus;
+    MemMapWR[slot] = mem ? writable : 0;
+}
+
 static uint8_t ula_io_read(uint16_t address) {
+    if (Sandbox) return 0xEE;
     // catch up the VDP before reading IO
     advance_vdp();
     // open bus value
@@ -59,23 +82,31 @@ static uint8_t ula_io_read(uint16_t address) {
         // F-page
         case IO_KEYB: {     // (read: KBRow)
             value = scanKeyCol(KbdCol);
+            KbdReads++;
             break;
         }
         case IO_LINE:       // (0-191 are visible lines)
             value = vdp_vcount & 0xFF;
             break;
+        case IO_DATA:       // (2:CTS 1:RXD 0:TapeIn)
+            value = (value & ~7) | serial_in() | tape_in();
+            break;
         default:
-            return 0xEE;    // open bus
+            break;          // open bus
     }
-    if (address != IO_KEYB) {
-        printf("IO Read: [$%02X] -> $%02X\n", address, value);
+    if (IoLogMask & ((uint64_t)1 << (address & 0x3F))) {
+        iolog_event(address, value, IOLOG_RD);
     }
     return value;
 }
 
 static void ula_io_write(uint16_t address, uint8_t value) {
+    if (Sandbox) return;
     // catch up the VDP before reading IO
     advance_vdp();
+    if (IoLogMask & ((uint64_t)1 << (address & 0x3F))) {
+        iolog_event(address, value, IOLOG_WR);
+    }
     // now write the IO value
     switch (address) {
         // F-page
@@ -101,14 +132,12 @@ static void ula_io_write(uint16_t address, uint8_t value) {
             break;
         case IO_DATA:       // (7-6:Volume 2:RTS 1:TXD 0:TapeOut)
             PSGVol = value >> 6;
+            serial_out(value);
+            tape_out(value & 1);
             break;
     }
     // write-through to RAM.
     MainRAM[address] = value;
-    // log IO writes (except keyboard row / irq ack)
-    if (address != IO_KEYB && address != IO_LINE) {
-        printf("IO Write: [$%02X] <- $%02X\n", address, value);
-    }
 }
 
 uint8_t read6502(uint16_t address) {